@@ -6,6 +6,9 @@
 #include <string.h>
 
 SM_FileHandle btree_fh;
+// the index file's handle on the shared buffer pool, when one is up
+BM_BufferPool btree_bm;
+bool btree_attached = FALSE;
 int elehigh;
 
 BTree *root;
@@ -60,12 +63,23 @@ RC createBtree(char *idxId, DataType keyType, int n) {
 }
 
 RC openBtree(BTreeHandle **tree, char *idxId) {
+    if (isSharedBufferPoolActive()) {
+        btree_attached = (attachBufferPool(&btree_bm, idxId) == RC_OK);
+        return btree_attached ? RC_OK : RC_ERROR;
+    }
     return (openPageFile(idxId, &btree_fh) == 0) ? RC_OK : RC_ERROR;
 }
 
 
 RC closeBtree(BTreeHandle *tree) {
-    int result = closePageFile(&btree_fh);
+    int result;
+    if (btree_attached) {
+        result = shutdownBufferPool(&btree_bm);
+        free(btree_bm.pageFile);
+        btree_attached = FALSE;
+    } else {
+        result = closePageFile(&btree_fh);
+    }
     return (result == 0) ? (free(root), RC_OK) : RC_ERROR;
 }
 
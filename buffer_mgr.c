@@ -1,11 +1,35 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <pthread.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/mman.h>
 
 #include "buffer_mgr.h"
 #include "storage_mgr.h"
 #include "dberror.h"
 
+// most page files one pool can serve at the same time
+#define MAX_POOL_FILES 32
+// frames are aligned to the page size so they can be used for direct I/O;
+// arenas of at least one huge page are mapped and advised to use huge pages
+#define FRAME_ALIGNMENT PAGE_SIZE
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// a page file attached to a pool, with its sequential read-ahead state
+typedef struct PoolFile
+{
+     SM_FileHandle fh;
+     bool inUse;
+     // read-only mapped file: frames hand out pointers into the mapping
+     bool mapped;
+     int readAheadDepth;
+     int sequentialRun;
+     PageNumber lastPinnedPage;
+     PageNumber readAheadEnd;
+}PoolFile;
+
 // Define Bufferpool
 typedef struct Bufferpool
 {
@@ -17,50 +41,294 @@ typedef struct Bufferpool
      int *updatedOrder;
      bool *bitdirty;
      int *fix_count;
+     // frames whose page is still being read; they are pinned, so nobody
+     // evicts them, and pins of the page wait on frameLoaded until they are done
+     bool *loading;
      int *accessTime;
      int *pagenum;
+     // frame arena, page aligned and kept apart from the per-frame metadata;
+     // arenaMapped tells whether it came from mmap or posix_memalign
      char *pagedata;
-     SM_FileHandle fhl;
+     size_t arenaBytes;
+     bool arenaMapped;
+     // frame buffers; the first baseFrames point into pagedata, frames added
+     // by resizeBufferPool are allocated one by one. Entries past totalPages
+     // up to frameCapacity are parked buffers kept for the next grow
+     char **frameData;
+     int baseFrames;
+     int frameCapacity;
+     // page files served by the pool and, per frame, which of them it caches;
+     // a private pool has file 0 only, the shared pool one per attached file
+     PoolFile files[MAX_POOL_FILES];
+     int *fileid;
+     bool shared;
+     // pool bookkeeping is guarded by poolLock. Reads run without any lock;
+     // ioLock serializes the writes and the calls that grow a page file
+     pthread_mutex_t poolLock;
+     pthread_mutex_t ioLock;
+     pthread_cond_t frameLoaded;
+     // broadcast whenever a frame may have come free for claimFrame, which
+     // pinPageWait waits for when every frame is pinned
+     pthread_cond_t frameFreed;
+     // background writer state
+     bool writerRunning;
+     pthread_t writerThread;
+     pthread_cond_t writerWakeup;
+     pthread_cond_t writerDone;
+     int lowWatermark;
+     int highWatermark;
+     int writerFrame;
+     bool writerRedirtied;
+     char *writerPage;
+     // asynchronous reads used by prefetching to keep many misses in flight,
+     // set up by the first prefetch. aioLock guards aio and finishedReads; it
+     // is taken after poolLock or alone, never the other way round
+     SM_AsyncIO aio;
+     bool aioReady;
+     bool aioFailed;
+     pthread_mutex_t aioLock;
+     struct PrefetchRead *finishedReads;
+     int prefetchesInFlight;
+     // counters reported by getPoolStats, guarded by poolLock
+     BM_PoolStats stats;
 }Bufferpool;
 
-bool pageFound = FALSE;
+// a prefetch read in flight; its frame is found again by page once it is
+// done, since frames move while the pool lock is not held
+typedef struct PrefetchRead
+{
+     Bufferpool *bp;
+     int fileId;
+     PageNumber pageNum;
+     RC rc;
+     struct timespec start;
+     struct PrefetchRead *next;
+}PrefetchRead;
+
+// a dirty frame queued for a coalesced flush
+typedef struct DirtyFrame
+{
+     PageNumber pageNum;
+     int frame;
+}DirtyFrame;
+
+// the pool tables and indexes attach to once initSharedBufferPool was called
+static Bufferpool *sharedBufferpool = NULL;
+static pthread_mutex_t sharedPoolLock = PTHREAD_MUTEX_INITIALIZER;
+
+// how long the background writer sleeps when nobody wakes it up
+#define WRITER_INTERVAL_MS 100
+// consecutive page pins before read-ahead kicks in, and its largest window
+#define SEQUENTIAL_TRIGGER 2
+#define MAX_READ_AHEAD 32
 
 //  Helper Functions
+static Bufferpool *createBufferpool(const int numPages, ReplacementStrategy strategy);
+static RC initPrivateBufferPool(BM_BufferPool *const bm, const char *const pageFileName, const int numPages, ReplacementStrategy strategy, bool mapped);
+static RC openPoolFile(Bufferpool *bp, const char *const pageFileName, bool mapped, int *fileId);
+static char *framePage(Bufferpool *bp, int frame);
+static RC detachBufferPool(BM_BufferPool *const bm);
 static RC writeDirtyPages(BM_BufferPool *const bm);
-static RC freeBufferPoolMemory(BM_BufferPool *const bm);
-static void ShiftUpdatedOrder(int start, int end, Bufferpool *bp, int newPageNum);
-static void UpdateBufferPoolStats(Bufferpool *bp, int memoryAddress, int pageNum);
+static RC writeDirtyFrames(Bufferpool *bp, int fileId);
+static RC freeBufferPoolMemory(Bufferpool *bp);
+static char *allocFrameArena(size_t bytes, bool *mapped);
+static void freeFrameArena(char *arena, size_t bytes, bool mapped);
+static char *allocFrame(void);
+static void ShiftUpdatedOrder(int start, int end, Bufferpool *bp, int frame);
+static void UpdateBufferPoolStats(Bufferpool *bp, int memoryAddress, int fileId, int pageNum);
+static RC pinPageInternal(BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber pageNum);
+static int findFrame(Bufferpool *bp, int fileId, PageNumber pageNum);
+static int findLoadedFrame(Bufferpool *bp, int fileId, PageNumber pageNum);
+static int claimFrame(Bufferpool *bp, bool cleanOnly);
+static int writeVictim(Bufferpool *bp, int frame);
+static void trackSequentialAccess(PoolFile *pf, PageNumber pageNum);
+static void readAheadIfSequential(Bufferpool *bp, int fileId, PageNumber pageNum);
+static int prefetchRange(Bufferpool *bp, int fileId, PageNumber first, int count);
+static void prefetchDone(SM_PageHandle memPage, int pageNum, RC rc, void *arg);
+static bool startAsyncIO(Bufferpool *bp);
+static void reapPrefetches(Bufferpool *bp);
+static void waitForPrefetch(Bufferpool *bp);
+static void drainPrefetches(Bufferpool *bp);
+static void publishPrefetches(Bufferpool *bp, PrefetchRead *done);
+static void releaseFrame(Bufferpool *bp, int frame);
+static bool waitForFreeFrame(Bufferpool *bp);
+static void lockPoolForPin(Bufferpool *bp);
+static bool isBaseFrame(Bufferpool *bp, char *frame);
+static RC evictFrame(Bufferpool *bp, int frame);
+static RC writeFrame(Bufferpool *bp, int frame);
+static long elapsedNanos(const struct timespec *start);
+static void recordLatency(long *histogram, long nanos);
+static void stopWriterThread(Bufferpool *bp);
+static void waitForBackgroundWrite(Bufferpool *bp);
+static int countCleanReserve(Bufferpool *bp);
+static int findColdDirtyFrame(Bufferpool *bp);
+static void *backgroundWriterMain(void *arg);
 
 // Define initBufferPool
 RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName, const int numPages, ReplacementStrategy strategy, void *stratData) {
-    SM_FileHandle fh;
+    return initPrivateBufferPool(bm, pageFileName, numPages, strategy, FALSE);
+}
+
+// Define init a buffer pool over a read-only, memory mapped page file
+RC initBufferPoolReadOnly(BM_BufferPool *const bm, const char *const pageFileName, const int numPages, ReplacementStrategy strategy) {
+    return initPrivateBufferPool(bm, pageFileName, numPages, strategy, TRUE);
+}
+
+// Helper function
+static RC initPrivateBufferPool(BM_BufferPool *const bm, const char *const pageFileName, const int numPages, ReplacementStrategy strategy, bool mapped) {
     Bufferpool *bp;
-    int rcode, i;
+    int fileId;
+    RC rcode;
 
-    rcode = openPageFile((char *)pageFileName, &fh);
+    bp = createBufferpool(numPages, strategy);
+    if (!bp) {
+        return RC_MEMORY_ALLOCATION_FAIL; 
+    }
+    rcode = openPoolFile(bp, pageFileName, mapped, &fileId);
     if (rcode != RC_OK) {
+        freeBufferPoolMemory(bp);
         return rcode; 
     }
+
+    if (bm != NULL) {
+        if (pageFileName != NULL) {
+            bm->pageFile = strdup(pageFileName); 
+        } else {
+            bm->pageFile = NULL;
+        }
+        bm->numPages = numPages;
+        bm->strategy = strategy;
+        bm->mgmtData = bp;
+        bm->fileId = fileId;
+        } 
+        return RC_OK;
+    }
+
+// Define init the shared buffer pool
+RC initSharedBufferPool(const int numPages, ReplacementStrategy strategy) {
+    if (numPages <= 0) {
+        return RC_ERROR;
+    }
+    pthread_mutex_lock(&sharedPoolLock);
+    if (sharedBufferpool != NULL) {
+        pthread_mutex_unlock(&sharedPoolLock);
+        return RC_BUFFERPOOL_IN_USE;
+    }
+    sharedBufferpool = createBufferpool(numPages, strategy);
+    if (sharedBufferpool == NULL) {
+        pthread_mutex_unlock(&sharedPoolLock);
+        return RC_MEMORY_ALLOCATION_FAIL;
+    }
+    sharedBufferpool->shared = TRUE;
+    pthread_mutex_unlock(&sharedPoolLock);
+    return RC_OK;
+}
+
+// Define shutdown the shared buffer pool
+RC shutdownSharedBufferPool(void) {
+    pthread_mutex_lock(&sharedPoolLock);
+    Bufferpool *bp = sharedBufferpool;
+    if (bp == NULL) {
+        pthread_mutex_unlock(&sharedPoolLock);
+        return RC_OK;
+    }
+    pthread_mutex_lock(&bp->poolLock);
+    for (int f = 0; f < MAX_POOL_FILES; f++) {
+        if (bp->files[f].inUse) {
+            pthread_mutex_unlock(&bp->poolLock);
+            pthread_mutex_unlock(&sharedPoolLock);
+            return RC_BUFFERPOOL_IN_USE;
+        }
+    }
+    pthread_mutex_unlock(&bp->poolLock);
+    stopWriterThread(bp);
+    sharedBufferpool = NULL;
+    pthread_mutex_unlock(&sharedPoolLock);
+    freeBufferPoolMemory(bp);
+    return RC_OK;
+}
+
+// Define is the shared buffer pool up
+bool isSharedBufferPoolActive(void) {
+    pthread_mutex_lock(&sharedPoolLock);
+    bool active = sharedBufferpool != NULL;
+    pthread_mutex_unlock(&sharedPoolLock);
+    return active;
+}
+
+// Define attach a page file to the shared buffer pool
+RC attachBufferPool(BM_BufferPool *const bm, const char *const pageFileName) {
+    int fileId;
+    RC rcode;
+
+    if (bm == NULL || pageFileName == NULL) {
+        return RC_ERROR;
+    }
+    pthread_mutex_lock(&sharedPoolLock);
+    Bufferpool *bp = sharedBufferpool;
+    if (bp == NULL) {
+        pthread_mutex_unlock(&sharedPoolLock);
+        return RC_ERROR;
+    }
+    pthread_mutex_lock(&bp->poolLock);
+    rcode = openPoolFile(bp, pageFileName, FALSE, &fileId);
+    pthread_mutex_unlock(&bp->poolLock);
+    pthread_mutex_unlock(&sharedPoolLock);
+    if (rcode != RC_OK) {
+        return rcode;
+    }
+
+    bm->pageFile = strdup(pageFileName);
+    bm->numPages = bp->totalPages;
+    bm->strategy = bp->updatedStrategy;
+    bm->mgmtData = bp;
+    bm->fileId = fileId;
+    return RC_OK;
+}
+
+// Helper function, allocates an empty pool with no page file attached
+static Bufferpool *createBufferpool(const int numPages, ReplacementStrategy strategy) {
+    Bufferpool *bp;
+    int i;
+
     bp = (Bufferpool *)calloc(1, sizeof(Bufferpool));
     if (!bp) {
-        return RC_MEMORY_ALLOCATION_FAIL; 
+        return NULL; 
     }
     bp->totalPages = numPages;
-    bp->pagedata = (char *)calloc(numPages * PAGE_SIZE, sizeof(char));
+    bp->arenaBytes = (size_t)numPages * PAGE_SIZE;
+    bp->pagedata = allocFrameArena(bp->arenaBytes, &bp->arenaMapped);
+    bp->frameData = (char **)calloc(numPages, sizeof(char *));
+    bp->baseFrames = numPages;
+    bp->frameCapacity = numPages;
     bp->numRead = 0;
     bp->numWrite = 0;
     bp->updatedOrder = (int *)calloc(numPages, sizeof(int));
     bp->bitdirty = (bool *)calloc(numPages, sizeof(bool));
     bp->free_space = numPages;
-    bp->fhl = fh;
     bp->pagenum = (int *)calloc(numPages, sizeof(int));
-
-    int arraySize = numPages * sizeof(int);
-    bool boolArraySize = numPages * sizeof(bool);
+    bp->fileid = (int *)calloc(numPages, sizeof(int));
     bp->fix_count = (int *)calloc(numPages, sizeof(int));
+    bp->loading = (bool *)calloc(numPages, sizeof(bool));
     bp->updatedStrategy = strategy;
+    pthread_mutex_init(&bp->poolLock, NULL);
+    pthread_mutex_init(&bp->ioLock, NULL);
+    pthread_cond_init(&bp->frameLoaded, NULL);
+    pthread_cond_init(&bp->frameFreed, NULL);
+    pthread_cond_init(&bp->writerWakeup, NULL);
+    pthread_cond_init(&bp->writerDone, NULL);
+    bp->writerRunning = FALSE;
+    bp->writerFrame = -1;
+    pthread_mutex_init(&bp->aioLock, NULL);
+    if (!bp->pagedata || !bp->frameData || !bp->updatedOrder || !bp->bitdirty ||
+        !bp->pagenum || !bp->fileid || !bp->fix_count || !bp->loading) {
+        freeBufferPoolMemory(bp);
+        return NULL;
+    }
 
-   
+    for (i = 0; i < numPages; i++) {
+        bp->frameData[i] = bp->pagedata + i * PAGE_SIZE;
+    }
 
     for (i = 0; i < numPages; i++) {
         bp->bitdirty[i] = FALSE;
@@ -77,73 +345,181 @@ RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName, const
     for (i = 0; i < numPages; i++) {
         bp->updatedOrder[i] = NO_PAGE;
     }
+    return bp;
+}
 
-    if (bm != NULL) {
-        if (pageFileName != NULL) {
-            bm->pageFile = strdup(pageFileName); 
-        } else {
-            bm->pageFile = NULL;
-        }
-        bm->numPages = numPages;
-        bm->strategy = strategy;
-        bm->mgmtData = bp;
-        if (bp != NULL) {
-        } 
-        } 
-        return RC_OK;
+// Helper function, caller holds poolLock on a pool other threads can see;
+// opens the page file into the first unused slot of the file table
+static RC openPoolFile(Bufferpool *bp, const char *const pageFileName, bool mapped, int *fileId) {
+    int f;
+    for (f = 0; f < MAX_POOL_FILES && bp->files[f].inUse; f++) {
+    }
+    if (f == MAX_POOL_FILES) {
+        return RC_BUFFERPOOL_FULL;
+    }
+    PoolFile *pf = &bp->files[f];
+    RC rcode = mapped ? openPageFileMapped((char *)pageFileName, &pf->fh)
+                      : openPageFile((char *)pageFileName, &pf->fh);
+    if (rcode != RC_OK) {
+        return rcode;
     }
+    pf->inUse = TRUE;
+    pf->mapped = mapped;
+    pf->readAheadDepth = bp->totalPages / 4 < MAX_READ_AHEAD ? bp->totalPages / 4 : MAX_READ_AHEAD;
+    pf->sequentialRun = 0;
+    pf->lastPinnedPage = NO_PAGE;
+    pf->readAheadEnd = 0;
+    *fileId = f;
+    return RC_OK;
+}
 
 // Define shutdown the buffer pool
 RC shutdownBufferPool(BM_BufferPool *const bm) {
     Bufferpool *bpl = bm->mgmtData;
-    
+
+    if (bpl->shared) {
+        return detachBufferPool(bm);
+    }
+    pthread_mutex_lock(&bpl->poolLock);
+    drainPrefetches(bpl);
     for (int i = 0; i < bpl->totalPages; i++) {
         if (bpl->fix_count[i] != 0) {
+            pthread_mutex_unlock(&bpl->poolLock);
             return RC_BUFFERPOOL_IN_USE;
         }
     }
+    pthread_mutex_unlock(&bpl->poolLock);
+    stopWriterThread(bpl);
     RC rc = writeDirtyPages(bm);
     if (rc != RC_OK) {
         return rc; 
     }
  
-    if (closePageFile(&bpl->fhl) != RC_OK) {
+    if (closePageFile(&bpl->files[bm->fileId].fh) != RC_OK) {
         return RC_CLOSE_FAILED;
     }
     
-    freeBufferPoolMemory(bm);
+    freeBufferPoolMemory(bpl);
+    bm->mgmtData = NULL;
     return RC_OK;
 }
 
+// Helper function, flushes and drops the pages of one file attached to the
+// shared pool; the pool and the pages of other files stay as they are
+static RC detachBufferPool(BM_BufferPool *const bm) {
+    Bufferpool *bpl = bm->mgmtData;
+    int fileId = bm->fileId;
+    RC rc;
+
+    pthread_mutex_lock(&bpl->poolLock);
+    drainPrefetches(bpl);
+    int usedFrames = bpl->totalPages - bpl->free_space;
+    for (int i = 0; i < usedFrames; i++) {
+        if (bpl->fileid[i] == fileId && bpl->pagenum[i] != NO_PAGE && bpl->fix_count[i] != 0) {
+            pthread_mutex_unlock(&bpl->poolLock);
+            return RC_BUFFERPOOL_IN_USE;
+        }
+    }
+    waitForBackgroundWrite(bpl);
+    pthread_mutex_lock(&bpl->ioLock);
+    rc = writeDirtyFrames(bpl, fileId);
+    pthread_mutex_unlock(&bpl->ioLock);
+    if (rc != RC_OK) {
+        pthread_mutex_unlock(&bpl->poolLock);
+        return rc;
+    }
+    // walk down so that the frames evictFrame moves into a slot were already seen
+    for (int i = usedFrames - 1; i >= 0; i--) {
+        if (bpl->fileid[i] == fileId) {
+            evictFrame(bpl, i);
+        }
+    }
+    pthread_cond_broadcast(&bpl->frameFreed);
+    pthread_mutex_lock(&bpl->ioLock);
+    rc = closePageFile(&bpl->files[fileId].fh);
+    pthread_mutex_unlock(&bpl->ioLock);
+    bpl->files[fileId].inUse = FALSE;
+    pthread_mutex_unlock(&bpl->poolLock);
+    bm->mgmtData = NULL;
+    return rc == RC_OK ? RC_OK : RC_CLOSE_FAILED;
+}
+
     // Helper function
     static RC writeDirtyPages(BM_BufferPool *const bm) {
         Bufferpool *bpl = bm->mgmtData;
-        for (int j = 0; j < bpl->totalPages; j++) {
-            if (bpl->bitdirty[j]) {
-                int record_pointer = j * PAGE_SIZE;
-                // Ensure capacity before writing
-                RC rc = ensureCapacity(bpl->pagenum[j] + 1, &bpl->fhl);
-                if (rc != RC_OK) {
-                    return rc;
-                }
-                // Write block
-                rc = writeBlock(bpl->pagenum[j], &bpl->fhl, (bpl->pagedata + record_pointer));
-                if (rc != RC_OK) {
-                    return RC_WRITE_FAILED;
-                }
-                bpl->numWrite++;
+        pthread_mutex_lock(&bpl->poolLock);
+        pthread_mutex_lock(&bpl->ioLock);
+        RC rc = writeDirtyFrames(bpl, bm->fileId);
+        pthread_mutex_unlock(&bpl->ioLock);
+        pthread_mutex_unlock(&bpl->poolLock);
+        return rc;
+    }
+
+    // Helper function, orders dirty frames by their page number
+    static int compareDirtyFrames(const void *left, const void *right) {
+        const DirtyFrame *l = left;
+        const DirtyFrame *r = right;
+        return (l->pageNum > r->pageNum) - (l->pageNum < r->pageNum);
+    }
+
+    // Helper function, caller holds poolLock and ioLock; writes every unpinned
+    // dirty frame of the file in page order, one vectored write per run of
+    // adjacent pages
+    static RC writeDirtyFrames(Bufferpool *bp, int fileId) {
+        SM_FileHandle *fh = &bp->files[fileId].fh;
+        int usedFrames = bp->totalPages - bp->free_space;
+        int numDirty = 0;
+        RC rc = RC_OK;
+        if (usedFrames == 0) {
+            return RC_OK;
+        }
+        DirtyFrame *dirty = (DirtyFrame *)malloc(usedFrames * sizeof(DirtyFrame));
+        SM_PageHandle *run = (SM_PageHandle *)malloc(usedFrames * sizeof(SM_PageHandle));
+        if (dirty == NULL || run == NULL) {
+            free(dirty);
+            free(run);
+            return RC_MEMORY_ALLOCATION_FAIL;
+        }
+        for (int i = 0; i < usedFrames; i++) {
+            if (bp->fix_count[i] == 0 && bp->bitdirty[i] && bp->pagenum[i] != NO_PAGE && bp->fileid[i] == fileId) {
+                dirty[numDirty].pageNum = bp->pagenum[i];
+                dirty[numDirty].frame = i;
+                numDirty++;
             }
         }
-        return RC_OK;
+        if (numDirty > 0) {
+            qsort(dirty, numDirty, sizeof(DirtyFrame), compareDirtyFrames);
+            // grow the file once for the highest page instead of once per page
+            rc = ensureCapacity(dirty[numDirty - 1].pageNum + 1, fh);
+        }
+        for (int start = 0, end; rc == RC_OK && start < numDirty; start = end) {
+            run[0] = bp->frameData[dirty[start].frame];
+            for (end = start + 1; end < numDirty && dirty[end].pageNum == dirty[end - 1].pageNum + 1; end++) {
+                run[end - start] = bp->frameData[dirty[end].frame];
+            }
+            struct timespec start_time;
+            clock_gettime(CLOCK_MONOTONIC, &start_time);
+            rc = writeBlocks(dirty[start].pageNum, end - start, fh, run);
+            if (rc != RC_OK) {
+                rc = RC_WRITE_FAILED;
+                break;
+            }
+            recordLatency(bp->stats.writeLatency, elapsedNanos(&start_time));
+            for (int k = start; k < end; k++) {
+                bp->bitdirty[dirty[k].frame] = FALSE;
+                bp->numWrite++;
+            }
+        }
+        free(dirty);
+        free(run);
+        return rc;
     }
 
     // Helper function
-    static RC freeBufferPoolMemory(BM_BufferPool *const bm)
+    static RC freeBufferPoolMemory(Bufferpool *bpl)
                 
             {
-        if (bm != NULL) {
-            Bufferpool *bpl = bm->mgmtData;
-            if (bpl != NULL) {
+        if (bpl != NULL) {
                 if (bpl->updatedOrder != NULL) {
                     free(bpl->updatedOrder);
                     bpl->updatedOrder = NULL; 
@@ -152,6 +528,10 @@ RC shutdownBufferPool(BM_BufferPool *const bm) {
                     free(bpl->pagenum);
                     bpl->pagenum = NULL; 
                 }
+                if (bpl->fileid != NULL) {
+                    free(bpl->fileid);
+                    bpl->fileid = NULL;
+                }
                 if (bpl->bitdirty != NULL) {
                     free(bpl->bitdirty);
                     bpl->bitdirty = NULL; 
@@ -160,14 +540,34 @@ RC shutdownBufferPool(BM_BufferPool *const bm) {
                     free(bpl->fix_count);
                     bpl->fix_count = NULL;
                 }
+                if (bpl->loading != NULL) {
+                    free(bpl->loading);
+                    bpl->loading = NULL;
+                }
+                if (bpl->frameData != NULL) {
+                    for (int i = 0; i < bpl->frameCapacity; i++) {
+                        if (!isBaseFrame(bpl, bpl->frameData[i])) {
+                            free(bpl->frameData[i]);
+                        }
+                    }
+                    free(bpl->frameData);
+                    bpl->frameData = NULL;
+                }
                 if (bpl->pagedata != NULL) {
-                    free(bpl->pagedata);
+                    freeFrameArena(bpl->pagedata, bpl->arenaBytes, bpl->arenaMapped);
                     bpl->pagedata = NULL; 
                 }
+                if (bpl->aioReady) {
+                    shutdownAsyncIO(&bpl->aio);
+                }
+                pthread_mutex_destroy(&bpl->aioLock);
+                pthread_mutex_destroy(&bpl->poolLock);
+                pthread_mutex_destroy(&bpl->ioLock);
+                pthread_cond_destroy(&bpl->frameLoaded);
+                pthread_cond_destroy(&bpl->frameFreed);
+                pthread_cond_destroy(&bpl->writerWakeup);
+                pthread_cond_destroy(&bpl->writerDone);
                 free(bpl);
-                bm->mgmtData = NULL;
-            } else {
-            }
             return RC_OK;
         } else {
             return RC_ERROR; 
@@ -175,238 +575,960 @@ RC shutdownBufferPool(BM_BufferPool *const bm) {
 
         return RC_OK;
 }
+// Helper function, zeroed frame arena; large arenas are mmapped on a huge page
+// boundary with MADV_HUGEPAGE, everything else falls back to posix_memalign
+static char *allocFrameArena(size_t bytes, bool *mapped) {
+    char *arena = NULL;
+
+    *mapped = FALSE;
+#ifdef MADV_HUGEPAGE
+    if (bytes >= HUGE_PAGE_SIZE) {
+        size_t mapBytes = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        // over-map by one huge page and trim so the arena starts on a boundary
+        char *raw = mmap(NULL, mapBytes + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw != MAP_FAILED) {
+            uintptr_t start = ((uintptr_t)raw + HUGE_PAGE_SIZE - 1) & ~((uintptr_t)HUGE_PAGE_SIZE - 1);
+            size_t head = start - (uintptr_t)raw;
+            if (head > 0) {
+                munmap(raw, head);
+            }
+            munmap((char *)start + mapBytes, HUGE_PAGE_SIZE - head);
+            arena = (char *)start;
+            // only a hint; the kernel may still back the arena with small pages
+            madvise(arena, mapBytes, MADV_HUGEPAGE);
+            *mapped = TRUE;
+            return arena;
+        }
+    }
+#endif
+    if (posix_memalign((void **)&arena, FRAME_ALIGNMENT, bytes) != 0) {
+        return NULL;
+    }
+    memset(arena, 0, bytes);
+    return arena;
+}
+
+// Helper function
+static void freeFrameArena(char *arena, size_t bytes, bool mapped) {
+    if (mapped) {
+        munmap(arena, (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE);
+    } else {
+        free(arena);
+    }
+}
+
+// Helper function, a single zeroed frame with the same alignment as the arena
+static char *allocFrame(void) {
+    char *frame = NULL;
+    if (posix_memalign((void **)&frame, FRAME_ALIGNMENT, PAGE_SIZE) != 0) {
+        return NULL;
+    }
+    memset(frame, 0, PAGE_SIZE);
+    return frame;
+}
+
     // Define flush the bufferpool
     RC forceFlushPool(BM_BufferPool *const bm) {
         Bufferpool *bpl;
         int rcode = RC_OK;
         bpl = bm->mgmtData;
-
-        for (int i = 0; bpl != NULL && i < bpl->totalPages; i++) {
-                if (bpl->fix_count[i] == 0 && bpl->bitdirty[i] == TRUE) {
-                FILE *file = fopen(bpl->fhl.fileName, "r+");
-                fseek(file, 0, SEEK_END);
-                long fileSize = ftell(file);
-                long requiredSize = (bpl->pagenum[i] + 1) * PAGE_SIZE;
-                if (fileSize < requiredSize) {
-                    fseek(file, requiredSize - 1, SEEK_SET);
-                    fputc('\0', file);
-                }
-                fclose(file);
-                file = fopen(bpl->fhl.fileName, "r+");
-                if (file == NULL) {
-                    rcode = RC_WRITE_FAILED;
-                    break;
-                }
-                int record_pointer = i * PAGE_SIZE;
-                fseek(file, bpl->pagenum[i] * PAGE_SIZE, SEEK_SET);
-                if (fwrite(bpl->pagedata + record_pointer, sizeof(char), PAGE_SIZE, file) != PAGE_SIZE) {
-                    rcode = RC_WRITE_FAILED;
-                    fclose(file);
-                    break; 
-                }
-                if (file != NULL) {
-                    fclose(file);
-                    file = NULL; 
-                }
-                if (bpl != NULL) {
-                    if (i >= 0) {
-                       if (bpl != NULL) {
-                        *(bpl->bitdirty + i) = FALSE;
-                        (*bpl).numWrite++;
-                    }
-
-                    } 
-                } 
-            }
+        if (bpl == NULL) {
+            return RC_OK;
         }
+
+        pthread_mutex_lock(&bpl->poolLock);
+        waitForBackgroundWrite(bpl);
+        pthread_mutex_lock(&bpl->ioLock);
+        rcode = writeDirtyFrames(bpl, bm->fileId);
+        pthread_mutex_unlock(&bpl->ioLock);
+        pthread_mutex_unlock(&bpl->poolLock);
         return rcode; 
     }
 
     // Define  pin a page 
 RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, 
             const PageNumber pageNum)
+{
+    Bufferpool *bpl = bm->mgmtData;
+    RC rc;
+
+    lockPoolForPin(bpl);
+    reapPrefetches(bpl);
+    rc = pinPageInternal(bm, page, pageNum);
+    // let the background writer top up the clean reserve after the pin
+    if (bpl->writerRunning) {
+        pthread_cond_signal(&bpl->writerWakeup);
+    }
+    pthread_mutex_unlock(&bpl->poolLock);
+    return rc;
+}
+
+// Define pin a page, waiting for a frame when every frame is pinned
+RC pinPageWait (BM_BufferPool *const bm, BM_PageHandle *const page,
+            const PageNumber pageNum)
+{
+    Bufferpool *bpl = bm->mgmtData;
+    RC rc;
+
+    lockPoolForPin(bpl);
+    reapPrefetches(bpl);
+    // the pool lock is dropped while waiting, so the lookup starts over
+    do {
+        rc = pinPageInternal(bm, page, pageNum);
+    } while (rc == RC_BUFFERPOOL_FULL && waitForFreeFrame(bpl));
+    if (bpl->writerRunning) {
+        pthread_cond_signal(&bpl->writerWakeup);
+    }
+    pthread_mutex_unlock(&bpl->poolLock);
+    return rc;
+}
+
+    // Helper function, caller holds poolLock; a miss releases it while the
+    // page is read and takes it again before returning
+static RC pinPageInternal (BM_BufferPool *const bm, BM_PageHandle *const page, 
+            const PageNumber pageNum)
     {
-        Bufferpool *buffer_pool;
-        bool void_page=FALSE;
-        bool foundedPage=FALSE;
-        bool UpdatedStra_found=FALSE;
-        int read_code;
-        int record_pointer;
+        Bufferpool *buffer_pool = bm->mgmtData;
+        int fileId = bm->fileId;
         int memory_address;
-        int swap_location;
-        
-        SM_PageHandle page_handle;
-        buffer_pool=bm->mgmtData;
-        buffer_pool = bm->mgmtData;
-        
-        void_page = (buffer_pool->free_space == buffer_pool->totalPages) ? TRUE : void_page;
-       if (!void_page) {
-        int totalPages = buffer_pool->totalPages - buffer_pool->free_space;
-        for (int i = 0; i < totalPages; i++) {
-
-            if (buffer_pool->pagenum[i] == pageNum) {
-                page->pageNum = pageNum;
-                int memory_address = i;
-                buffer_pool->fix_count[memory_address]++;
-                page->data = &buffer_pool->pagedata[memory_address * PAGE_SIZE];
-                foundedPage = TRUE;
-                if (buffer_pool->updatedStrategy == RS_LRU) {
-                        int lastPosition = buffer_pool->totalPages - buffer_pool->free_space - 1; 
-                        swap_location = -1; 
-                        for (int j = 0; j <= lastPosition; j++) 
-                            if (buffer_pool->updatedOrder[j] != pageNum) {
-                                if (j == buffer_pool->totalPages - 1) {
-                                    swap_location = -1;
-                                }
-                             } else {
-                                swap_location = j;
-                                break;
-                            }
-                            if (swap_location != -1) {
-                                memmove(&buffer_pool->updatedOrder[swap_location], &buffer_pool->updatedOrder[swap_location + 1], (lastPosition - swap_location) * sizeof(buffer_pool->updatedOrder[0]));
-                                buffer_pool->updatedOrder[lastPosition] = pageNum;
-                            }
+        SM_PageHandle frame_data;
+
+        trackSequentialAccess(&buffer_pool->files[fileId], pageNum);
+
+        memory_address = findLoadedFrame(buffer_pool, fileId, pageNum);
+        if (memory_address != -1) {
+            buffer_pool->stats.hits++;
+            buffer_pool->fix_count[memory_address]++;
+            if (memory_address == buffer_pool->writerFrame) {
+                buffer_pool->writerRedirtied = TRUE;
+            }
+            if (buffer_pool->updatedStrategy == RS_LRU) {
+                int lastPosition = buffer_pool->totalPages - buffer_pool->free_space - 1;
+                for (int j = 0; j <= lastPosition; j++) {
+                    if (buffer_pool->updatedOrder[j] == memory_address) {
+                        memmove(&buffer_pool->updatedOrder[j], &buffer_pool->updatedOrder[j + 1], (lastPosition - j) * sizeof(buffer_pool->updatedOrder[0]));
+                        buffer_pool->updatedOrder[lastPosition] = memory_address;
+                        buffer_pool->stats.lruPromotions++;
+                        break;
                     }
-                                else {
-                                    int unutilized = 0;
-                                    do {
-                                    } while (++unutilized < 1);
-                            }
-                return RC_OK;
+                }
             }
+            page->pageNum = pageNum;
+            page->data = framePage(buffer_pool, memory_address);
+            readAheadIfSequential(buffer_pool, fileId, pageNum);
+            return RC_OK;
+        }
+
+        if (buffer_pool->files[fileId].mapped) {
+            // nothing to read, the frame only tracks the pin on the mapped page
+            RC map_code = mapBlock(pageNum, &buffer_pool->files[fileId].fh, &frame_data);
+            if (map_code == RC_OK) {
+                map_code = verifyPageChecksum(frame_data);
             }
-        } 
+            if (map_code != RC_OK) {
+                return map_code;
+            }
+            memory_address = claimFrame(buffer_pool, FALSE);
+            if (memory_address == -1) {
+                return RC_BUFFERPOOL_FULL;
+            }
+            if (findFrame(buffer_pool, fileId, pageNum) != -1) {
+                // pinned by another thread while claimFrame wrote its victim
+                releaseFrame(buffer_pool, memory_address);
+                return pinPageInternal(bm, page, pageNum);
+            }
+            buffer_pool->stats.misses++;
+            UpdateBufferPoolStats(buffer_pool, memory_address, fileId, pageNum);
+            page->pageNum = pageNum;
+            page->data = frame_data;
+            readAheadIfSequential(buffer_pool, fileId, pageNum);
+            return RC_OK;
+        }
+        memory_address = claimFrame(buffer_pool, FALSE);
+        if (memory_address == -1) {
+            return RC_BUFFERPOOL_FULL;
+        }
+        if (findFrame(buffer_pool, fileId, pageNum) != -1) {
+            // pinned by another thread while claimFrame wrote its victim
+            releaseFrame(buffer_pool, memory_address);
+            return pinPageInternal(bm, page, pageNum);
+        }
+        buffer_pool->stats.misses++;
+        // the frame is pinned and marked loading, so the pool lock can go
+        // while the page is read straight into it
+        buffer_pool->pagenum[memory_address] = pageNum;
+        buffer_pool->fileid[memory_address] = fileId;
+        buffer_pool->bitdirty[memory_address] = FALSE;
+        buffer_pool->fix_count[memory_address]++;
+        buffer_pool->loading[memory_address] = TRUE;
+        frame_data = buffer_pool->frameData[memory_address];
+        pthread_mutex_unlock(&buffer_pool->poolLock);
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        RC read_code = readBlock(pageNum, &buffer_pool->files[fileId].fh, frame_data);
+        long nanos = elapsedNanos(&start);
+        pthread_mutex_lock(&buffer_pool->poolLock);
 
-        if ((void_page == TRUE && buffer_pool != NULL && (1 == 1)) || 
-        ((foundedPage != TRUE && foundedPage == FALSE) && buffer_pool->free_space > 0 && 
-        buffer_pool->free_space <= buffer_pool->totalPages && buffer_pool->free_space == buffer_pool->free_space && 
-        (buffer_pool->free_space != -1 && buffer_pool->totalPages != -1) && 
-        (buffer_pool->free_space >= 0 && buffer_pool->totalPages >= buffer_pool->free_space) && 
-        ((buffer_pool->free_space + 1) > 1) && ((buffer_pool->totalPages - buffer_pool->free_space) >= 0)))
-            {
-        page_handle = (SM_PageHandle)calloc(1, PAGE_SIZE);
-        if (page_handle != NULL) {
-
-            read_code = readBlock(pageNum, &buffer_pool->fhl, page_handle);
-            if (read_code >= 0) {
-                size_t total_used_pages = buffer_pool->totalPages - buffer_pool->free_space;
-                memory_address = total_used_pages;
-                if (memory_address >= 0 && memory_address <= buffer_pool->totalPages) {
-                    size_t base_address = 0; 
-                    record_pointer = (memory_address * PAGE_SIZE) + base_address;
-
-                } 
-            } 
-        }
-                memcpy(buffer_pool->pagedata + record_pointer, page_handle, PAGE_SIZE);
-                buffer_pool->free_space--;
-                buffer_pool->updatedOrder[memory_address] = pageNum;
-                buffer_pool->pagenum[memory_address] = pageNum;
-                buffer_pool->numRead++;
-                buffer_pool->fix_count[memory_address]++;
-                buffer_pool->bitdirty[memory_address] = FALSE;
-                page->pageNum = pageNum;
-                page->data = &(buffer_pool->pagedata[record_pointer]);
-                free(page_handle);
-
-                return RC_OK;
+        // the frame may have moved to another slot in the meantime
+        memory_address = findFrame(buffer_pool, fileId, pageNum);
+        buffer_pool->loading[memory_address] = FALSE;
+        pthread_cond_broadcast(&buffer_pool->frameLoaded);
+        recordLatency(buffer_pool->stats.readLatency, nanos);
+        if (read_code == RC_CHECKSUM_FAILED) {
+            // never hand out a torn page, the caller has to deal with it
+            buffer_pool->fix_count[memory_address]--;
+            releaseFrame(buffer_pool, memory_address);
+            pthread_cond_broadcast(&buffer_pool->frameFreed);
+            return read_code;
+        }
+        if (read_code != RC_OK) {
+            // pages past the end of file are handed out zeroed
+            memset(frame_data, 0, PAGE_SIZE);
+        }
+        buffer_pool->numRead++;
+        page->pageNum = pageNum;
+        page->data = frame_data;
+        readAheadIfSequential(buffer_pool, fileId, pageNum);
+        return RC_OK; 
+}
+
+// Helper function, the page a frame hands out to pinPage
+static char *framePage(Bufferpool *bp, int frame) {
+    PoolFile *pf = &bp->files[bp->fileid[frame]];
+    SM_PageHandle mappedPage;
+    if (pf->mapped && mapBlock(bp->pagenum[frame], &pf->fh, &mappedPage) == RC_OK) {
+        return mappedPage;
+    }
+    return bp->frameData[frame];
+}
+
+// Helper function, the frame holding pageNum of the file or -1
+static int findFrame(Bufferpool *bp, int fileId, PageNumber pageNum) {
+    int usedFrames = bp->totalPages - bp->free_space;
+    for (int i = 0; i < usedFrames; i++) {
+        if (bp->pagenum[i] == pageNum && bp->fileid[i] == fileId) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Helper function, like findFrame, but waits for a frame that is still being
+// read; the pool lock is released while waiting, so frames may move. With
+// prefetches in flight the waiter reaps them itself, as nobody else may
+static int findLoadedFrame(Bufferpool *bp, int fileId, PageNumber pageNum) {
+    int frame = findFrame(bp, fileId, pageNum);
+    while (frame != -1 && bp->loading[frame]) {
+        if (bp->prefetchesInFlight > 0) {
+            waitForPrefetch(bp);
+        } else {
+            pthread_cond_wait(&bp->frameLoaded, &bp->poolLock);
+        }
+        frame = findFrame(bp, fileId, pageNum);
+    }
+    return frame;
+}
+
+// Helper function, hands out the next free frame or evicts the first unpinned
+// page in replacement order; prefetching passes cleanOnly so it never writes.
+// updatedOrder holds frame indexes, coldest first. A dirty victim is written
+// with the pool lock released, so callers must look their page up again
+static int claimFrame(Bufferpool *bp, bool cleanOnly) {
+    int usedFrames = bp->totalPages - bp->free_space;
+    if (bp->free_space > 0) {
+        bp->free_space--;
+        bp->updatedOrder[usedFrames] = usedFrames;
+        return usedFrames;
+    }
+    if (bp->updatedStrategy != RS_FIFO && bp->updatedStrategy != RS_LRU) {
+        return -1;
+    }
+    // the pool may change while a victim is written, so the bound is read
+    // again every round; after a failed write the walk goes on from there
+    for (int j = 0; j < bp->totalPages - bp->free_space; j++) {
+        int i = bp->updatedOrder[j];
+        if (bp->fix_count[i] != 0 || i == bp->writerFrame) {
+            continue;
+        }
+        if (bp->bitdirty[i]) {
+            if (cleanOnly) {
+                continue;
             }
-       
-            bool isPageNotFound = !foundedPage;
-            bool isBufferPoolValid = buffer_pool != NULL;
-            bool isBufferPoolFull = buffer_pool->free_space == 0;
+            i = writeVictim(bp, i);
+            if (i == -1) {
+                continue;
+            }
+            for (j = 0; bp->updatedOrder[j] != i; j++) {
+            }
+            bp->stats.dirtyEvictions++;
+        } else {
+            bp->stats.cleanEvictions++;
+        }
+        ShiftUpdatedOrder(j, bp->totalPages - bp->free_space - 1, bp, i);
+        return i;
+    }
+    return -1;
+}
 
-            if (isPageNotFound && isBufferPoolValid && isBufferPoolFull)
-            {
-            UpdatedStra_found = FALSE;
-            page_handle = (SM_PageHandle) malloc(PAGE_SIZE);
-            if (page_handle != NULL) {
-                memset(page_handle, 0, PAGE_SIZE);
+// Helper function, caller holds poolLock; writes a dirty victim back with the
+// pool lock released, the way a miss reads its page. The frame is pinned and
+// marked loading meanwhile, so nobody evicts, pins or dirties it. Returns the
+// frame, which may have moved, or -1 if the write failed and it stays dirty
+static int writeVictim(Bufferpool *bp, int frame) {
+    int fileId = bp->fileid[frame];
+    PageNumber pageNum = bp->pagenum[frame];
+    SM_FileHandle *fh = &bp->files[fileId].fh;
+    char *data = bp->frameData[frame];
+
+    bp->fix_count[frame]++;
+    bp->loading[frame] = TRUE;
+    pthread_mutex_unlock(&bp->poolLock);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_mutex_lock(&bp->ioLock);
+    RC rc = ensureCapacity(pageNum + 1, fh);
+    if (rc == RC_OK) {
+        rc = writeBlock(pageNum, fh, data);
+    }
+    pthread_mutex_unlock(&bp->ioLock);
+    long nanos = elapsedNanos(&start);
+    pthread_mutex_lock(&bp->poolLock);
+
+    frame = findFrame(bp, fileId, pageNum);
+    bp->fix_count[frame]--;
+    bp->loading[frame] = FALSE;
+    pthread_cond_broadcast(&bp->frameLoaded);
+    if (rc != RC_OK) {
+        pthread_cond_broadcast(&bp->frameFreed);
+        return -1;
+    }
+    recordLatency(bp->stats.writeLatency, nanos);
+    bp->numWrite++;
+    bp->bitdirty[frame] = FALSE;
+    return frame;
+}
+
+// Define resize the buffer pool
+RC resizeBufferPool(BM_BufferPool *const bm, const int newNumPages) {
+    Bufferpool *bpl;
+    RC rc = RC_OK;
+    if (bm == NULL || bm->mgmtData == NULL) {
+        return RC_ERROR;
+    }
+    if (newNumPages <= 0) {
+        return RC_ERROR;
+    }
+    bpl = bm->mgmtData;
+    pthread_mutex_lock(&bpl->poolLock);
+    drainPrefetches(bpl);
+    waitForBackgroundWrite(bpl);
+
+    int usedFrames = bpl->totalPages - bpl->free_space;
+    // shrinking: evict cold unpinned pages until the used frames fit
+    for (int j = 0; usedFrames > newNumPages && j < usedFrames; ) {
+        int i = bpl->updatedOrder[j];
+        if (bpl->fix_count[i] != 0) {
+            j++;
+            continue;
+        }
+        rc = evictFrame(bpl, i);
+        if (rc != RC_OK) {
+            break;
+        }
+        usedFrames--;
+    }
+    if (rc == RC_OK && usedFrames > newNumPages) {
+        rc = RC_BUFFERPOOL_IN_USE;
+    }
+    if (rc != RC_OK) {
+        pthread_mutex_unlock(&bpl->poolLock);
+        return rc;
+    }
+
+    if (newNumPages < bpl->totalPages) {
+        // free the grown buffers past the new size, park the ones from pagedata
+        int kept = newNumPages;
+        for (int i = newNumPages; i < bpl->frameCapacity; i++) {
+            if (isBaseFrame(bpl, bpl->frameData[i])) {
+                bpl->frameData[kept++] = bpl->frameData[i];
+            } else {
+                free(bpl->frameData[i]);
             }
-            read_code = readBlock(pageNum, &buffer_pool->fhl, page_handle);
-
-
-            if (buffer_pool->updatedStrategy == RS_FIFO || buffer_pool->updatedStrategy == RS_LRU) {
-                int i = 0, j = 0;
-                do {
-                    int swap_page = buffer_pool->updatedOrder[j];
-                    i = 0; 
-                    do {
-                        if (buffer_pool->pagenum[i] == swap_page && buffer_pool->fix_count[i] == 0) {
-                            memory_address = i;
-                            record_pointer = i * PAGE_SIZE;
-                            if (buffer_pool->bitdirty[i]) {
-                                read_code = ensureCapacity(buffer_pool->pagenum[i] + 1, &buffer_pool->fhl);
-                                read_code = writeBlock(buffer_pool->pagenum[i], &buffer_pool->fhl, buffer_pool->pagedata + record_pointer);
-                                buffer_pool->numWrite++;
-                            }
-                            swap_location = j;
-                            UpdatedStra_found = TRUE;
-                            break; 
-                        }
-                        i++;
-                    } while (i < buffer_pool->totalPages && !UpdatedStra_found);
-                    j++;
-                    if (UpdatedStra_found) break; 
-                } while (j < buffer_pool->totalPages);
+        }
+        bpl->frameCapacity = kept;
+    } else if (newNumPages > bpl->frameCapacity) {
+        char **frameData = (char **)realloc(bpl->frameData, newNumPages * sizeof(char *));
+        if (frameData == NULL) {
+            pthread_mutex_unlock(&bpl->poolLock);
+            return RC_MEMORY_ALLOCATION_FAIL;
+        }
+        bpl->frameData = frameData;
+        while (bpl->frameCapacity < newNumPages) {
+            bpl->frameData[bpl->frameCapacity] = allocFrame();
+            if (bpl->frameData[bpl->frameCapacity] == NULL) {
+                pthread_mutex_unlock(&bpl->poolLock);
+                return RC_MEMORY_ALLOCATION_FAIL;
             }
+            bpl->frameCapacity++;
+        }
+    }
+
+    int *updatedOrder = (int *)realloc(bpl->updatedOrder, newNumPages * sizeof(int));
+    if (updatedOrder != NULL) {
+        bpl->updatedOrder = updatedOrder;
+    }
+    int *pagenum = (int *)realloc(bpl->pagenum, newNumPages * sizeof(int));
+    if (pagenum != NULL) {
+        bpl->pagenum = pagenum;
+    }
+    int *fileid = (int *)realloc(bpl->fileid, newNumPages * sizeof(int));
+    if (fileid != NULL) {
+        bpl->fileid = fileid;
+    }
+    int *fix_count = (int *)realloc(bpl->fix_count, newNumPages * sizeof(int));
+    if (fix_count != NULL) {
+        bpl->fix_count = fix_count;
+    }
+    bool *bitdirty = (bool *)realloc(bpl->bitdirty, newNumPages * sizeof(bool));
+    if (bitdirty != NULL) {
+        bpl->bitdirty = bitdirty;
+    }
+    bool *loading = (bool *)realloc(bpl->loading, newNumPages * sizeof(bool));
+    if (loading != NULL) {
+        bpl->loading = loading;
+    }
+    if (updatedOrder == NULL || pagenum == NULL || fileid == NULL || fix_count == NULL || bitdirty == NULL ||
+        loading == NULL) {
+        // the arrays that did move are still large enough for the old size
+        pthread_mutex_unlock(&bpl->poolLock);
+        return RC_MEMORY_ALLOCATION_FAIL;
+    }
+    for (int i = bpl->totalPages; i < newNumPages; i++) {
+        bpl->updatedOrder[i] = NO_PAGE;
+        bpl->pagenum[i] = NO_PAGE;
+        bpl->fileid[i] = 0;
+        bpl->fix_count[i] = 0;
+        bpl->bitdirty[i] = FALSE;
+        bpl->loading[i] = FALSE;
+    }
+    bpl->free_space += newNumPages - bpl->totalPages;
+    bpl->totalPages = newNumPages;
+    for (int f = 0; f < MAX_POOL_FILES; f++) {
+        if (bpl->files[f].readAheadDepth > newNumPages / 2) {
+            bpl->files[f].readAheadDepth = newNumPages / 2;
         }
+    }
+    bm->numPages = newNumPages;
+    pthread_cond_broadcast(&bpl->frameFreed);
+    pthread_mutex_unlock(&bpl->poolLock);
+    return RC_OK;
+}
 
+// Helper function, caller holds poolLock; writes the frame back if needed and
+// moves the last used frame into its slot so used frames stay packed in front
+static RC evictFrame(Bufferpool *bp, int frame) {
+    int usedFrames = bp->totalPages - bp->free_space;
+    int lastFrame = usedFrames - 1;
 
-         if (UpdatedStra_found == FALSE) {
-            free(page_handle);
-            return RC_BUFFERPOOL_FULL;
-        } else {
-            record_pointer = memory_address * PAGE_SIZE;
-            int i = 0;
-            if (i < PAGE_SIZE) {
-                do {
-                    buffer_pool->pagedata[i + record_pointer] = page_handle[i];
-                    i++;
-                } while (i < PAGE_SIZE);
+    if (bp->bitdirty[frame]) {
+        RC rc = writeFrame(bp, frame);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        bp->stats.dirtyEvictions++;
+    } else {
+        bp->stats.cleanEvictions++;
+    }
+    for (int j = 0; j < usedFrames; j++) {
+        if (bp->updatedOrder[j] == frame) {
+            memmove(&bp->updatedOrder[j], &bp->updatedOrder[j + 1], (usedFrames - j - 1) * sizeof(bp->updatedOrder[0]));
+            bp->updatedOrder[usedFrames - 1] = NO_PAGE;
+            break;
+        }
+    }
+    if (frame != lastFrame) {
+        char *evicted = bp->frameData[frame];
+        for (int j = 0; j < usedFrames - 1; j++) {
+            if (bp->updatedOrder[j] == lastFrame) {
+                bp->updatedOrder[j] = frame;
+                break;
             }
         }
-            
-        // Main logic
-        if (buffer_pool->updatedStrategy == RS_LRU || buffer_pool->updatedStrategy == RS_FIFO) {
-            ShiftUpdatedOrder(swap_location, buffer_pool->totalPages - 1, buffer_pool, pageNum);
-        } 
-        UpdateBufferPoolStats(buffer_pool, memory_address, pageNum);
-        page->pageNum = pageNum;
-        page->data = buffer_pool->pagedata + record_pointer;
-        free(page_handle); 
-        return RC_OK; 
+        bp->frameData[frame] = bp->frameData[lastFrame];
+        bp->pagenum[frame] = bp->pagenum[lastFrame];
+        bp->fileid[frame] = bp->fileid[lastFrame];
+        bp->bitdirty[frame] = bp->bitdirty[lastFrame];
+        bp->fix_count[frame] = bp->fix_count[lastFrame];
+        bp->loading[frame] = bp->loading[lastFrame];
+        bp->frameData[lastFrame] = evicted;
+    }
+    bp->pagenum[lastFrame] = NO_PAGE;
+    bp->bitdirty[lastFrame] = FALSE;
+    bp->fix_count[lastFrame] = 0;
+    bp->loading[lastFrame] = FALSE;
+    bp->free_space++;
+    return RC_OK;
+}
+
+// Helper function, caller holds poolLock; writes the frame to its page,
+// growing the file first if the page lies past its end
+static RC writeFrame(Bufferpool *bp, int frame) {
+    SM_FileHandle *fh = &bp->files[bp->fileid[frame]].fh;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_mutex_lock(&bp->ioLock);
+    RC rc = ensureCapacity(bp->pagenum[frame] + 1, fh);
+    if (rc == RC_OK) {
+        rc = writeBlock(bp->pagenum[frame], fh, bp->frameData[frame]);
+    }
+    pthread_mutex_unlock(&bp->ioLock);
+    if (rc != RC_OK) {
+        return RC_WRITE_FAILED;
+    }
+    recordLatency(bp->stats.writeLatency, elapsedNanos(&start));
+    bp->bitdirty[frame] = FALSE;
+    bp->numWrite++;
+    return RC_OK;
+}
+
+// Helper function, is the buffer part of the pagedata block
+static bool isBaseFrame(Bufferpool *bp, char *frame) {
+    return frame >= bp->pagedata && frame < bp->pagedata + (size_t)bp->baseFrames * PAGE_SIZE;
+}
+
+// Define prefetch a range of pages
+RC prefetchPages(BM_BufferPool *const bm, const PageNumber first, const int count) {
+    Bufferpool *bpl;
+    if (bm == NULL || bm->mgmtData == NULL) {
+        return RC_ERROR;
+    }
+    if (first < 0 || count < 0) {
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+    bpl = bm->mgmtData;
+    pthread_mutex_lock(&bpl->poolLock);
+    prefetchRange(bpl, bm->fileId, first, count);
+    pthread_mutex_unlock(&bpl->poolLock);
+    return RC_OK;
+}
+
+// Define set the read-ahead window
+RC setReadAheadDepth(BM_BufferPool *const bm, const int depth) {
+    Bufferpool *bpl;
+    if (bm == NULL || bm->mgmtData == NULL) {
+        return RC_ERROR;
+    }
+    bpl = bm->mgmtData;
+    PoolFile *pf = &bpl->files[bm->fileId];
+    pthread_mutex_lock(&bpl->poolLock);
+    if (depth < 0) {
+        pf->readAheadDepth = 0;
+    } else if (depth > bpl->totalPages / 2) {
+        // a window larger than half the pool would evict its own pages
+        pf->readAheadDepth = bpl->totalPages / 2;
+    } else {
+        pf->readAheadDepth = depth;
+    }
+    pthread_mutex_unlock(&bpl->poolLock);
+    return RC_OK;
+}
+
+// Helper function, counts how many pins in a row walked to the next page
+static void trackSequentialAccess(PoolFile *pf, PageNumber pageNum) {
+    if (pageNum == pf->lastPinnedPage + 1) {
+        pf->sequentialRun++;
+    } else if (pageNum != pf->lastPinnedPage) {
+        pf->sequentialRun = 0;
+    }
+    pf->lastPinnedPage = pageNum;
+}
+
+// Helper function, keeps the read-ahead window ahead of a sequential scan
+static void readAheadIfSequential(Bufferpool *bp, int fileId, PageNumber pageNum) {
+    PoolFile *pf = &bp->files[fileId];
+    if (pf->readAheadDepth <= 0 || pf->sequentialRun < SEQUENTIAL_TRIGGER) {
+        return;
+    }
+    // refill once the scan is half way through the window
+    if (pageNum + pf->readAheadDepth / 2 < pf->readAheadEnd) {
+        return;
+    }
+    PageNumber first = pf->readAheadEnd > pageNum ? pf->readAheadEnd : pageNum + 1;
+    PageNumber end = pageNum + 1 + pf->readAheadDepth;
+    prefetchRange(bp, fileId, first, end - first);
+    pf->readAheadEnd = end;
+}
+
+// Helper function, queues reads of pages into free or clean unpinned frames
+// and returns without waiting for them; stops at the end of file, when no
+// clean frame is left or when the read queue is full. The frames stay pinned
+// and loading until reapPrefetches publishes their page
+static int prefetchRange(Bufferpool *bp, int fileId, PageNumber first, int count) {
+    SM_FileHandle *fh = &bp->files[fileId].fh;
+    int submitted = 0;
+
+    if (count > bp->totalPages) {
+        count = bp->totalPages;
+    }
+    if (bp->files[fileId].mapped) {
+        // let the kernel fault the window in; pinning it costs no copy later
+        adviseBlocks(first, count, fh, SM_ADVICE_WILLNEED);
+        return 0;
+    }
+    if (count <= 0 || !startAsyncIO(bp)) {
+        return 0;
+    }
+    // a pin is waiting for a read to finish, the next pin can prefetch
+    if (pthread_mutex_trylock(&bp->aioLock) != 0) {
+        return 0;
+    }
+    int fileEnd = __atomic_load_n(&fh->totalNumPages, __ATOMIC_ACQUIRE);
+    for (PageNumber p = first; p < first + count && p < fileEnd && bp->aio.inFlight < bp->aio.queueDepth; p++) {
+        if (findFrame(bp, fileId, p) != -1) {
+            continue;
+        }
+        int frame = claimFrame(bp, TRUE);
+        if (frame == -1) {
+            break;
+        }
+        PrefetchRead *read = (PrefetchRead *)malloc(sizeof(PrefetchRead));
+        if (read == NULL) {
+            releaseFrame(bp, frame);
+            break;
+        }
+        bp->pagenum[frame] = p;
+        bp->fileid[frame] = fileId;
+        bp->bitdirty[frame] = FALSE;
+        bp->fix_count[frame]++;
+        bp->loading[frame] = TRUE;
+        read->bp = bp;
+        read->fileId = fileId;
+        read->pageNum = p;
+        read->next = NULL;
+        clock_gettime(CLOCK_MONOTONIC, &read->start);
+        if (submitRead(&bp->aio, fh, p, bp->frameData[frame], prefetchDone, read) != RC_OK) {
+            bp->fix_count[frame]--;
+            bp->loading[frame] = FALSE;
+            releaseFrame(bp, frame);
+            free(read);
+            break;
+        }
+        bp->prefetchesInFlight++;
+        submitted++;
+    }
+    pthread_mutex_unlock(&bp->aioLock);
+    return submitted;
+}
+
+// Helper function, completion of a prefetch read. Runs inside pollAsyncIO or
+// submitRead with aioLock held, so it only queues the read for publishing
+static void prefetchDone(SM_PageHandle memPage, int pageNum, RC rc, void *arg) {
+    PrefetchRead *read = arg;
+    read->rc = rc;
+    read->next = read->bp->finishedReads;
+    read->bp->finishedReads = read;
+}
+
+// Helper function, caller holds poolLock; sets up the read queue on the first
+// prefetch, so pools that never prefetch do not pay for it
+static bool startAsyncIO(Bufferpool *bp) {
+    if (!bp->aioReady && !bp->aioFailed) {
+        bp->aioReady = initAsyncIO(&bp->aio, MAX_READ_AHEAD, 0) == RC_OK;
+        bp->aioFailed = !bp->aioReady;
+    }
+    return bp->aioReady;
 }
 
-static void ShiftUpdatedOrder(int start, int end, Bufferpool *bp, int newPageNum) {
+// Helper function, caller holds poolLock; publishes the prefetches that
+// finished so far without waiting for the others
+static void reapPrefetches(Bufferpool *bp) {
+    if (bp->prefetchesInFlight == 0 || pthread_mutex_trylock(&bp->aioLock) != 0) {
+        return;
+    }
+    pollAsyncIO(&bp->aio, 0);
+    PrefetchRead *done = bp->finishedReads;
+    bp->finishedReads = NULL;
+    pthread_mutex_unlock(&bp->aioLock);
+    publishPrefetches(bp, done);
+}
+
+// Helper function, caller holds poolLock; waits for at least one prefetch with
+// the pool lock released, then publishes what finished
+static void waitForPrefetch(Bufferpool *bp) {
+    pthread_mutex_unlock(&bp->poolLock);
+    pthread_mutex_lock(&bp->aioLock);
+    pollAsyncIO(&bp->aio, 1);
+    PrefetchRead *done = bp->finishedReads;
+    bp->finishedReads = NULL;
+    pthread_mutex_unlock(&bp->aioLock);
+    pthread_mutex_lock(&bp->poolLock);
+    publishPrefetches(bp, done);
+}
+
+// Helper function, caller holds poolLock; waits until no prefetch is in flight
+static void drainPrefetches(Bufferpool *bp) {
+    while (bp->prefetchesInFlight > 0) {
+        waitForPrefetch(bp);
+    }
+}
+
+// Helper function, caller holds poolLock; unpins the frames of finished
+// prefetches and hands the pages out, or drops them when the read failed
+static void publishPrefetches(Bufferpool *bp, PrefetchRead *done) {
+    while (done != NULL) {
+        PrefetchRead *read = done;
+        done = read->next;
+        int frame = findFrame(bp, read->fileId, read->pageNum);
+        bp->fix_count[frame]--;
+        bp->loading[frame] = FALSE;
+        bp->prefetchesInFlight--;
+        if (read->rc != RC_OK) {
+            // hand the frame back as an empty, immediately evictable one
+            releaseFrame(bp, frame);
+        } else {
+            recordLatency(bp->stats.readLatency, elapsedNanos(&read->start));
+            bp->numRead++;
+            bp->stats.prefetchedPages++;
+        }
+        free(read);
+    }
+    pthread_cond_broadcast(&bp->frameLoaded);
+    pthread_cond_broadcast(&bp->frameFreed);
+}
+
+// Helper function, undoes claimFrame for a page that could not be loaded by
+// moving the now empty frame to the cold end of the replacement order
+static void releaseFrame(Bufferpool *bp, int frame) {
+    int usedFrames = bp->totalPages - bp->free_space;
+    for (int j = 0; j < usedFrames; j++) {
+        if (bp->updatedOrder[j] == frame) {
+            memmove(&bp->updatedOrder[1], &bp->updatedOrder[0], j * sizeof(bp->updatedOrder[0]));
+            bp->updatedOrder[0] = frame;
+            break;
+        }
+    }
+    bp->pagenum[frame] = NO_PAGE;
+    bp->bitdirty[frame] = FALSE;
+}
+
+// Helper function, caller holds poolLock; waits for something that may give
+// claimFrame a frame: a prefetch finishing, which the waiter reaps itself as
+// nobody else may, the background writer letting go of its frame, or a pin
+// being dropped. FALSE when no frame can come free, because the strategy
+// never evicts or no frame is pinned at all
+static bool waitForFreeFrame(Bufferpool *bp) {
+    int usedFrames = bp->totalPages - bp->free_space;
+    bool anyPinned = FALSE;
+
+    if (bp->updatedStrategy != RS_FIFO && bp->updatedStrategy != RS_LRU) {
+        return FALSE;
+    }
+    if (bp->prefetchesInFlight > 0) {
+        waitForPrefetch(bp);
+        return TRUE;
+    }
+    if (bp->writerFrame != -1) {
+        waitForBackgroundWrite(bp);
+        return TRUE;
+    }
+    for (int i = 0; i < usedFrames && !anyPinned; i++) {
+        anyPinned = bp->fix_count[i] > 0;
+    }
+    if (!anyPinned) {
+        return FALSE;
+    }
+    pthread_cond_wait(&bp->frameFreed, &bp->poolLock);
+    return TRUE;
+}
+
+static void ShiftUpdatedOrder(int start, int end, Bufferpool *bp, int frame) {
     for (int i = start; i < end; i++) {
         bp->updatedOrder[i] = bp->updatedOrder[i + 1];
     }
-    bp->updatedOrder[end] = newPageNum;
+    bp->updatedOrder[end] = frame;
 }
 
-static void UpdateBufferPoolStats(Bufferpool *bp, int memoryAddress, int pageNum) {
+static void UpdateBufferPoolStats(Bufferpool *bp, int memoryAddress, int fileId, int pageNum) {
     bp->pagenum[memoryAddress] = pageNum;
+    bp->fileid[memoryAddress] = fileId;
     bp->numRead += 1;
     bp->fix_count[memoryAddress] += 1;
     bp->bitdirty[memoryAddress] = FALSE;
 }
- 
+
+// Define start the background writer
+RC startBackgroundWriter(BM_BufferPool *const bm, int lowWatermark, int highWatermark) {
+    Bufferpool *bpl;
+    if (bm == NULL || bm->mgmtData == NULL) {
+        return RC_ERROR;
+    }
+    bpl = bm->mgmtData;
+    if (lowWatermark < 0 || highWatermark < lowWatermark || highWatermark > bpl->totalPages) {
+        return RC_ERROR;
+    }
+    pthread_mutex_lock(&bpl->poolLock);
+    bpl->lowWatermark = lowWatermark;
+    bpl->highWatermark = highWatermark;
+    if (bpl->writerRunning) {
+        pthread_cond_signal(&bpl->writerWakeup);
+        pthread_mutex_unlock(&bpl->poolLock);
+        return RC_OK;
+    }
+    bpl->writerPage = (char *)malloc(PAGE_SIZE);
+    if (bpl->writerPage == NULL) {
+        pthread_mutex_unlock(&bpl->poolLock);
+        return RC_MEMORY_ALLOCATION_FAIL;
+    }
+    bpl->writerRunning = TRUE;
+    if (pthread_create(&bpl->writerThread, NULL, backgroundWriterMain, bpl) != 0) {
+        bpl->writerRunning = FALSE;
+        free(bpl->writerPage);
+        bpl->writerPage = NULL;
+        pthread_mutex_unlock(&bpl->poolLock);
+        return RC_ERROR;
+    }
+    pthread_mutex_unlock(&bpl->poolLock);
+    return RC_OK;
+}
+
+// Define stop the background writer
+RC stopBackgroundWriter(BM_BufferPool *const bm) {
+    if (bm == NULL || bm->mgmtData == NULL) {
+        return RC_ERROR;
+    }
+    stopWriterThread(bm->mgmtData);
+    return RC_OK;
+}
+
+// Helper function, joins the writer thread if one is running
+static void stopWriterThread(Bufferpool *bpl) {
+    pthread_mutex_lock(&bpl->poolLock);
+    if (!bpl->writerRunning) {
+        pthread_mutex_unlock(&bpl->poolLock);
+        return;
+    }
+    bpl->writerRunning = FALSE;
+    pthread_cond_signal(&bpl->writerWakeup);
+    pthread_mutex_unlock(&bpl->poolLock);
+
+    pthread_join(bpl->writerThread, NULL);
+    free(bpl->writerPage);
+    bpl->writerPage = NULL;
+}
+
+// Helper function, caller holds poolLock
+static void waitForBackgroundWrite(Bufferpool *bp) {
+    while (bp->writerFrame != -1) {
+        pthread_cond_wait(&bp->writerDone, &bp->poolLock);
+    }
+}
+
+// Helper function, free frames plus clean frames nobody has pinned
+static int countCleanReserve(Bufferpool *bp) {
+    int reserve = bp->free_space;
+    int usedFrames = bp->totalPages - bp->free_space;
+    for (int i = 0; i < usedFrames; i++) {
+        if (bp->fix_count[i] == 0 && !bp->bitdirty[i]) {
+            reserve++;
+        }
+    }
+    return reserve;
+}
+
+// Helper function, the coldest unpinned dirty frame in replacement order
+static int findColdDirtyFrame(Bufferpool *bp) {
+    int usedFrames = bp->totalPages - bp->free_space;
+    for (int j = 0; j < usedFrames; j++) {
+        int i = bp->updatedOrder[j];
+        if (bp->fix_count[i] == 0 && bp->bitdirty[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Helper function, writes cold dirty frames back so that pinPage finds clean victims
+static void *backgroundWriterMain(void *arg) {
+    Bufferpool *bp = arg;
+    bool refilling = FALSE;
+    struct timespec deadline;
+
+    pthread_mutex_lock(&bp->poolLock);
+    while (bp->writerRunning) {
+        int reserve = countCleanReserve(bp);
+        int frame = -1;
+        if (reserve < bp->lowWatermark) {
+            refilling = TRUE;
+        } else if (reserve >= bp->highWatermark) {
+            refilling = FALSE;
+        }
+        if (refilling) {
+            frame = findColdDirtyFrame(bp);
+        }
+        if (frame == -1) {
+            refilling = FALSE;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += (long)WRITER_INTERVAL_MS * 1000000L;
+            deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+            pthread_cond_timedwait(&bp->writerWakeup, &bp->poolLock, &deadline);
+            continue;
+        }
+
+        // write a private copy so that the pool lock is not held across the I/O
+        PageNumber pageNum = bp->pagenum[frame];
+        SM_FileHandle *fh = &bp->files[bp->fileid[frame]].fh;
+        memcpy(bp->writerPage, bp->frameData[frame], PAGE_SIZE);
+        bp->writerFrame = frame;
+        bp->writerRedirtied = FALSE;
+        pthread_mutex_unlock(&bp->poolLock);
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        pthread_mutex_lock(&bp->ioLock);
+        RC rc = ensureCapacity(pageNum + 1, fh);
+        if (rc == RC_OK) {
+            rc = writeBlock(pageNum, fh, bp->writerPage);
+        }
+        pthread_mutex_unlock(&bp->ioLock);
+        long nanos = elapsedNanos(&start);
+
+        pthread_mutex_lock(&bp->poolLock);
+        if (rc == RC_OK) {
+            recordLatency(bp->stats.writeLatency, nanos);
+            bp->numWrite++;
+            bp->stats.writerWrites++;
+            if (!bp->writerRedirtied) {
+                bp->bitdirty[frame] = FALSE;
+            }
+        } else {
+            refilling = FALSE;
+        }
+        bp->writerFrame = -1;
+        pthread_cond_broadcast(&bp->writerDone);
+        pthread_cond_broadcast(&bp->frameFreed);
+    }
+    pthread_mutex_unlock(&bp->poolLock);
+    return NULL;
+}
+
 // Define unpin a page 
 RC unpinPage(BM_BufferPool *const bm, BM_PageHandle *const page) {
     Bufferpool *bufferPool = bm->mgmtData;
     int SearchResultIndex = -1;
-    for (int i = 0; i < bufferPool->totalPages; i++) {
-        if (bufferPool->pagenum[i] == page->pageNum) {
-            SearchResultIndex = i;
-            break; 
-        }
-    }
+    pthread_mutex_lock(&bufferPool->poolLock);
+    SearchResultIndex = findFrame(bufferPool, bm->fileId, page->pageNum);
     if (SearchResultIndex != -1) {
         if (bufferPool->fix_count[SearchResultIndex] > 0) {
             bufferPool->fix_count[SearchResultIndex]--;
+            if (bufferPool->fix_count[SearchResultIndex] == 0) {
+                pthread_cond_broadcast(&bufferPool->frameFreed);
+            }
         } 
     } 
+    reapPrefetches(bufferPool);
+    pthread_mutex_unlock(&bufferPool->poolLock);
     return RC_OK;
 }
 
@@ -415,38 +1537,43 @@ RC markDirty(BM_BufferPool *const bm, BM_PageHandle *const page) {
     Bufferpool *bpl;
     int markedCount = 0; 
     bpl = bm->mgmtData;
+    if (bpl->files[bm->fileId].mapped) {
+        return RC_WRITE_FAILED;
+    }
+    pthread_mutex_lock(&bpl->poolLock);
     for (int i = 0; i < bpl->totalPages; i++) {
-        if (bpl->pagenum[i] == page->pageNum) {
+        if (bpl->pagenum[i] == page->pageNum && bpl->fileid[i] == bm->fileId) {
             if (bpl->bitdirty[i] != TRUE) {
                 bpl->bitdirty[i] = TRUE; 
                 markedCount++; 
             }
+            if (i == bpl->writerFrame) {
+                bpl->writerRedirtied = TRUE;
+            }
             break; 
         }
     }
+    pthread_mutex_unlock(&bpl->poolLock);
     return RC_OK;
 }
 
 // Define force a page
 RC forcePage(BM_BufferPool *const bm, BM_PageHandle *const page) {
     Bufferpool *bpl;
+    RC rc = RC_WRITE_FAILED;
     bpl = bm->mgmtData;
-    for(int i = 0; i < bpl->totalPages; i++) {
-        if(bpl->pagenum[i] == page->pageNum) {
-            int record_pointer = i * PAGE_SIZE;
-            printf("Simulated writing of page %d to disk at position %d.\n", page->pageNum, record_pointer);
-            bpl->bitdirty[i] = FALSE;
-            bpl->numWrite++;
-            pageFound = TRUE;
-            break;
-        }
-    }
-    if (pageFound) {
-        return RC_OK;
-    } else {
-        printf("Page %d not found in buffer pool.\n", page->pageNum);
+    if (bpl->files[bm->fileId].mapped) {
         return RC_WRITE_FAILED;
     }
+    pthread_mutex_lock(&bpl->poolLock);
+    findLoadedFrame(bpl, bm->fileId, page->pageNum);
+    waitForBackgroundWrite(bpl);
+    int frame = findFrame(bpl, bm->fileId, page->pageNum);
+    if (frame != -1 && !bpl->loading[frame]) {
+        rc = writeFrame(bpl, frame);
+    }
+    pthread_mutex_unlock(&bpl->poolLock);
+    return rc;
 }
 
 // Define fixed counts of the pages 
@@ -463,10 +1590,8 @@ int *getFixCounts (BM_BufferPool *const bm) {
     }
     if (bpl->free_space == bpl->totalPages) {
         static int noFixes = 0; 
-        printf("All pages are available. No fixes are present.\n");
         return &noFixes;
     } else {
-        printf("Returning fix counts for pages in use.\n");
         return bpl->fix_count;
     }
 }
@@ -502,6 +1627,74 @@ int getNumWriteIO(BM_BufferPool *const bm) {
     }
 }
 
+// Define a snapshot of the pool counters
+RC getPoolStats(BM_BufferPool *const bm, BM_PoolStats *stats) {
+    if (bm == NULL || bm->mgmtData == NULL || stats == NULL) {
+        return RC_ERROR;
+    }
+    Bufferpool *bpl = bm->mgmtData;
+    pthread_mutex_lock(&bpl->poolLock);
+    *stats = bpl->stats;
+    stats->strategy = bpl->updatedStrategy;
+    stats->numReadIO = bpl->numRead;
+    stats->numWriteIO = bpl->numWrite;
+    stats->totalFrames = bpl->totalPages;
+    stats->usedFrames = bpl->totalPages - bpl->free_space;
+    stats->pinnedFrames = 0;
+    stats->dirtyFrames = 0;
+    for (int i = 0; i < stats->usedFrames; i++) {
+        if (bpl->fix_count[i] > 0) {
+            stats->pinnedFrames++;
+        }
+        if (bpl->bitdirty[i]) {
+            stats->dirtyFrames++;
+        }
+    }
+    stats->nextVictim = NO_PAGE;
+    if (bpl->updatedStrategy == RS_FIFO || bpl->updatedStrategy == RS_LRU) {
+        for (int j = 0; j < stats->usedFrames && stats->nextVictim == NO_PAGE; j++) {
+            int i = bpl->updatedOrder[j];
+            if (bpl->fix_count[i] == 0) {
+                stats->nextVictim = bpl->pagenum[i];
+            }
+        }
+    }
+    stats->readAheadDepth = bpl->files[bm->fileId].readAheadDepth;
+    stats->writerRunning = bpl->writerRunning;
+    pthread_mutex_unlock(&bpl->poolLock);
+    return RC_OK;
+}
+
+// Helper function, takes the pool lock and accounts for the time a pin waited
+static void lockPoolForPin(Bufferpool *bp) {
+    struct timespec start;
+    if (pthread_mutex_trylock(&bp->poolLock) == 0) {
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_mutex_lock(&bp->poolLock);
+    bp->stats.pinWaits++;
+    bp->stats.pinWaitNanos += elapsedNanos(&start);
+}
+
+// Helper function
+static long elapsedNanos(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000000L + (now.tv_nsec - start->tv_nsec);
+}
+
+// Helper function, adds one I/O to a log2 microsecond histogram
+static void recordLatency(long *histogram, long nanos) {
+    long micros = nanos / 1000;
+    int bucket = 0;
+    while (micros > 1 && bucket < BM_LATENCY_BUCKETS - 1) {
+        micros >>= 1;
+        bucket++;
+    }
+    histogram[bucket]++;
+}
+
 // Define the page numbers as an array 
 PageNumber *getFrameContents(BM_BufferPool *const bm)
 {
@@ -55,8 +55,48 @@ typedef struct BM_BufferPool {
     // extended by ourselves
     int numReads;
     int numWrites;
+    // which page file of the pool this handle works on, 0 for a private pool
+    int fileId;
 } BM_BufferPool;
 
+// latency histograms use log2 buckets: bucket 0 counts I/Os under 2us,
+// bucket k those in [2^k, 2^(k+1)) us, the last bucket everything slower
+#define BM_LATENCY_BUCKETS 16
+
+// snapshot of the pool counters, filled by getPoolStats
+typedef struct BM_PoolStats {
+    // the pool's own replacement strategy, the shared pool's for attached files
+    ReplacementStrategy strategy;
+    long hits;
+    long misses;
+    long cleanEvictions;
+    long dirtyEvictions;
+    // pins that found the pool locked and how long they waited in total
+    long pinWaits;
+    long pinWaitNanos;
+    long numReadIO;
+    long numWriteIO;
+    long readLatency[BM_LATENCY_BUCKETS];
+    long writeLatency[BM_LATENCY_BUCKETS];
+    // frame occupancy at the time of the snapshot; totalFrames is the pool's
+    // current size, also after another handle of a shared pool resized it
+    int totalFrames;
+    int usedFrames;
+    int pinnedFrames;
+    int dirtyFrames;
+    // replacement strategy internals: the page a FIFO or LRU pool evicts next
+    // and how often LRU moved a hit page to the hot end. CLOCK, LFU and LRU_K
+    // pools never evict, so for them nextVictim stays NO_PAGE and a pin of a
+    // new page fails with RC_BUFFERPOOL_FULL once every frame is used
+    PageNumber nextVictim;
+    long lruPromotions;
+    // read-ahead and background writer
+    int readAheadDepth;
+    long prefetchedPages;
+    bool writerRunning;
+    long writerWrites;
+} BM_PoolStats;
+
 // convenience macros
 #define MAKE_POOL()					\
 		((BM_BufferPool *) malloc (sizeof(BM_BufferPool)))
@@ -68,8 +108,25 @@ typedef struct BM_BufferPool {
 RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName,
                   const int numPages, ReplacementStrategy strategy,
                   void *stratData);
+// pool over a read-only page file mapped into memory: pins return pointers
+// into the mapping without copying and markDirty fails with RC_WRITE_FAILED
+RC initBufferPoolReadOnly(BM_BufferPool *const bm, const char *const pageFileName,
+                  const int numPages, ReplacementStrategy strategy);
 RC shutdownBufferPool(BM_BufferPool *const bm);
 RC forceFlushPool(BM_BufferPool *const bm);
+// grows or shrinks the pool in place; shrinking evicts the coldest unpinned
+// pages first and fails with RC_BUFFERPOOL_IN_USE if too many are pinned
+RC resizeBufferPool(BM_BufferPool *const bm, const int newNumPages);
+
+// Shared Buffer Pool Interface
+// one pool whose frames are keyed by (file, page) and shared by every page
+// file attached to it; shutdownBufferPool on an attached handle flushes and
+// drops that file's pages only. shutdownSharedBufferPool tears the pool down
+// and fails with RC_BUFFERPOOL_IN_USE while any file is still attached
+RC initSharedBufferPool(const int numPages, ReplacementStrategy strategy);
+RC shutdownSharedBufferPool(void);
+bool isSharedBufferPoolActive(void);
+RC attachBufferPool(BM_BufferPool *const bm, const char *const pageFileName);
 
 // Buffer Manager Interface Access Pages
 RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page);
@@ -77,6 +134,24 @@ RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page,
             const PageNumber pageNum);
+// like pinPage, but when every frame is pinned it waits for one to come free
+// instead of failing with RC_BUFFERPOOL_FULL. Only FIFO and LRU pools wait,
+// and only while some frame is pinned; a caller that holds every pinned
+// frame itself would wait forever
+RC pinPageWait (BM_BufferPool *const bm, BM_PageHandle *const page,
+            const PageNumber pageNum);
+
+// Prefetch Interface
+// queues reads of pages into free or clean unpinned frames and returns without
+// waiting for them; pins of a page still being read wait for that read
+RC prefetchPages (BM_BufferPool *const bm, const PageNumber first, const int count);
+// pages read ahead once pins walk the file sequentially, 0 disables it
+RC setReadAheadDepth (BM_BufferPool *const bm, const int depth);
+
+// Background Writer Interface
+// keeps at least lowWatermark..highWatermark free or clean unpinned frames
+RC startBackgroundWriter (BM_BufferPool *const bm, int lowWatermark, int highWatermark);
+RC stopBackgroundWriter (BM_BufferPool *const bm);
 
 // Statistics Interface
 PageNumber *getFrameContents (BM_BufferPool *const bm);
@@ -84,5 +159,6 @@ bool *getDirtyFlags (BM_BufferPool *const bm);
 int *getFixCounts (BM_BufferPool *const bm);
 int getNumReadIO (BM_BufferPool *const bm);
 int getNumWriteIO (BM_BufferPool *const bm);
+RC getPoolStats (BM_BufferPool *const bm, BM_PoolStats *stats);
 
 #endif
@@ -6,6 +6,7 @@
 
 // local functions
 static void printStrat (BM_BufferPool *const bm);
+static const char *strategyName (ReplacementStrategy strategy);
 
 // external functions
 void 
@@ -78,28 +79,82 @@ sprintPageContent (BM_PageHandle *const page)
 	return message;
 }
 
+void
+printPoolStats (BM_BufferPool *const bm)
+{
+	char *message = sprintPoolStats(bm);
+
+	if (message == NULL)
+		return;
+	printf("%s", message);
+	free(message);
+}
+
+char *
+sprintPoolStats (BM_BufferPool *const bm)
+{
+	BM_PoolStats stats;
+	char *message;
+	long pins;
+	int i;
+	int pos = 0;
+
+	if (getPoolStats(bm, &stats) != RC_OK)
+		return NULL;
+
+	message = (char *) malloc(1024 + 2 * BM_LATENCY_BUCKETS * 24);
+	pins = stats.hits + stats.misses;
+	pos += sprintf(message + pos, "hits %li misses %li hit ratio %.2f%%\n", stats.hits, stats.misses,
+			(pins == 0) ? 0.0 : 100.0 * stats.hits / pins);
+	pos += sprintf(message + pos, "evictions clean %li dirty %li\n", stats.cleanEvictions, stats.dirtyEvictions);
+	pos += sprintf(message + pos, "pin waits %li total %li us\n", stats.pinWaits, stats.pinWaitNanos / 1000);
+	pos += sprintf(message + pos, "frames used %i pinned %i dirty %i of %i\n", stats.usedFrames, stats.pinnedFrames,
+			stats.dirtyFrames, stats.totalFrames);
+	pos += sprintf(message + pos, "read IO %li write IO %li\n", stats.numReadIO, stats.numWriteIO);
+	pos += sprintf(message + pos, "read latency us:");
+	for (i = 0; i < BM_LATENCY_BUCKETS; i++)
+		pos += sprintf(message + pos, " %s%li:%li", (i == BM_LATENCY_BUCKETS - 1) ? ">=" : "<",
+				(i == BM_LATENCY_BUCKETS - 1) ? (1L << i) : (2L << i), stats.readLatency[i]);
+	pos += sprintf(message + pos, "\nwrite latency us:");
+	for (i = 0; i < BM_LATENCY_BUCKETS; i++)
+		pos += sprintf(message + pos, " %s%li:%li", (i == BM_LATENCY_BUCKETS - 1) ? ">=" : "<",
+				(i == BM_LATENCY_BUCKETS - 1) ? (1L << i) : (2L << i), stats.writeLatency[i]);
+	pos += sprintf(message + pos, "\nstrategy %s next victim %i lru promotions %li\n",
+			(strategyName(stats.strategy) == NULL) ? "unknown" : strategyName(stats.strategy),
+			stats.nextVictim, stats.lruPromotions);
+	pos += sprintf(message + pos, "read-ahead depth %i prefetched %li\n", stats.readAheadDepth, stats.prefetchedPages);
+	pos += sprintf(message + pos, "background writer %s writes %li\n", stats.writerRunning ? "on" : "off", stats.writerWrites);
+
+	return message;
+}
+
 void
 printStrat (BM_BufferPool *const bm)
 {
-	switch (bm->strategy)
+	const char *name = strategyName(bm->strategy);
+
+	if (name == NULL)
+		printf("%i", bm->strategy);
+	else
+		printf("%s", name);
+}
+
+const char *
+strategyName (ReplacementStrategy strategy)
+{
+	switch (strategy)
 	{
 	case RS_FIFO:
-		printf("FIFO");
-		break;
+		return "FIFO";
 	case RS_LRU:
-		printf("LRU");
-		break;
+		return "LRU";
 	case RS_CLOCK:
-		printf("CLOCK");
-		break;
+		return "CLOCK";
 	case RS_LFU:
-		printf("LFU");
-		break;
+		return "LFU";
 	case RS_LRU_K:
-		printf("LRU-K");
-		break;
+		return "LRU-K";
 	default:
-		printf("%i", bm->strategy);
-		break;
+		return NULL;
 	}
 }
@@ -5,6 +5,9 @@
 
 /* module wide constants */
 #define PAGE_SIZE 4096
+// the last bytes of every page hold its checksum, the rest is page data
+#define PAGE_CHECKSUM_SIZE 4
+#define PAGE_DATA_SIZE (PAGE_SIZE - PAGE_CHECKSUM_SIZE)
 
 /* return code definitions */
 typedef int RC;
@@ -37,6 +40,8 @@ typedef int RC;
 #define RC_SEEK_FAILED 408
 #define RC_DESTROY_FAILED 409
 #define RC_GENERAL_ERROR 411
+#define RC_CHECKSUM_FAILED 412
+#define RC_TABLE_FORMAT_UNSUPPORTED 413
 #define RC_RECORD_NOT_FOUND 410
 #define RC_SHUTDOWN_WITHOUT_INIT 420
 #define RC_LOGGING_SETUP_FAILURE 430
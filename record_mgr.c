@@ -1,6 +1,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <pthread.h>
 
 #include "tables.h"
 #include "buffer_mgr.h"
@@ -10,10 +11,102 @@
 
 #define MAX_ATTR_NAME_LEN 15
 
+// flags in the high bits of SlotEntry.length. A forwarded slot holds the RID
+// its body moved to when an update outgrew the page; the moved body is
+// reachable only through that stub, so scans skip it
+#define SLOT_FORWARDED 0x8000
+#define SLOT_MOVED 0x4000
+#define SLOT_LENGTH_MASK 0x3FFF
+// offset of the last free entry on a page's free slot chain
+#define NO_FREE_SLOT 0xFFFF
+// what conditionAttr reports for conditions reading no or several attributes
+#define COND_NO_ATTR -1
+#define COND_MANY_ATTRS -2
+// data pages a parallel scan worker takes at a time
+#define SCAN_MORSEL_PAGES 16
+// the table header on page 0 starts with these two ints; bump the version
+// whenever the header or page format changes so older files are rejected
+#define TABLE_HEADER_MAGIC 0x54424C45
+#define TABLE_FORMAT_VERSION 1
+#define TABLE_HEADER_PREFIX_INTS 2
+
+// one worker's share of a parallel scan: it takes morsels from next, idle
+// workers steal them from end
+typedef struct MorselQueue {
+    pthread_mutex_t lock;
+    int next;
+    int end;
+} MorselQueue;
+
+// state shared by the workers of startParallelScan; status is the first
+// failure and stops every worker, guarded by statusLock
+typedef struct ParallelScan {
+    RM_TableData *rel;
+    Expr *cond;
+    int filterAttr;
+    RM_ScanCallback callback;
+    void *arg;
+    int numWorkers;
+    MorselQueue *queues;
+    pthread_mutex_t statusLock;
+    RC status;
+} ParallelScan;
+
+typedef struct ScanWorker {
+    ParallelScan *scan;
+    int id;
+    pthread_t thread;
+    bool started;
+} ScanWorker;
+
 extern int getAttrPos (Schema *schema, int attrNum);
 static void prepareTableHeader(char **tableHeaderPtr, TableManager *tableManager, Schema *schema);
 static void populateSchemaDetails(char **tableHeaderPtr, Schema *schema);
 static void handleCleanup(BM_BufferPool *bufferPool, BM_PageHandle *pageHandle, TableManager *tableManager); 
+static RC initTableBufferPool(BM_BufferPool *bufferPool, char *name, RM_TableOptions *options);
+static RC writeTableCounters(TableManager *tableManager);
+static SlotEntry *slotDirectory(char *pageData);
+static SlotEntry *findRecordSlot(char *pageData, int slot);
+static void initDataPage(char *pageData);
+static void compactPage(char *pageData);
+static int allocSlot(char *pageData, int length);
+static bool resizeSlot(char *pageData, int slot, int length, int flags);
+static void releaseSlot(TableManager *tableMgmt, char *pageData, int pageNum, int slot);
+static void noteFreeSpace(TableManager *tableMgmt, char *pageData, int pageNum);
+static RC placeRecordBody(TableManager *tableMgmt, const char *body, int length, int flags, RID *id);
+static RC pinInsertPage(TableManager *tableMgmt, BM_PageHandle *pageHandle, int length);
+static bool bodyFits(PageHeader *header, int length);
+static RC rowInsertRecords(RM_TableData *rel, Record **records, int numRecords);
+static void leaveFreeListIfFull(TableManager *tableMgmt, PageHeader *header);
+static int encodeRecord(Schema *schema, const char *data, char *body);
+static void decodeRecord(Schema *schema, const char *body, char *data, int recSize, const bool *attrMask);
+static int attrStoredSize(Schema *schema, int attrNum);
+static void computeBodyLimits(Schema *schema, int *minBytes, int *maxBytes);
+static RC setupPaxColumns(TableManager *tableManager, Schema *schema);
+static void initPaxPage(char *pageData, int slotsPerPage);
+static RC paxInsertRecords(TableManager *tableMgmt, Record **records, int numRecords);
+static RC paxGetRecord(TableManager *tableMgmt, RID id, Record *record);
+static RC paxUpdateRecord(TableManager *tableMgmt, Record *record);
+static RC paxDeleteRecord(TableManager *tableMgmt, RID id);
+static void paxGather(TableManager *tableMgmt, char *pageData, int slot, char *data, int attrNum, bool onlyAttr);
+static void paxGatherMasked(TableManager *tableMgmt, char *pageData, int slot, char *data, const bool *attrMask, int skipAttr);
+static RC readRowSlot(RM_TableData *rel, char *pageData, int slot, char *data, const bool *attrMask, bool waitForFrame);
+static int slotsOnPage(TableManager *tableMgr, char *pageData);
+static void releaseScanPage(TableManager *tableMgr, BM_PageHandle *scanPage);
+static RC scanSlot(RM_TableData *rel, ScanManager *scanMgr, char *pageData, int slot, Record *record, Expr *cond, bool *matches);
+static RC scanNextRecord(RM_ScanHandle *scan, Record *record, Expr *cond, bool *matches);
+static int evalBatch(RM_TableData *rel, RecordBatch *batch, Expr *expr, int *rows, int numRows, int *selected);
+static int compareBatch(RM_TableData *rel, RecordBatch *batch, Operator *op, int *rows, int numRows, int *selected);
+static bool conditionHolds(Record *record, Schema *schema, Expr *cond);
+static int conditionAttr(Expr *expr);
+static void markConditionAttrs(Expr *cond, bool *attrMask);
+static void projectRecord(ScanManager *scanMgr, const char *rowData, char *data);
+static int scanFilterAttr(TableManager *tableManager, Expr *cond);
+static void *parallelScanWorker(void *arg);
+static int takeMorsel(ParallelScan *scan, int workerId);
+static RC scanMorsel(ParallelScan *scan, ScanManager *slotFilter, int morsel, Record *record);
+static bool parallelScanRunning(ParallelScan *scan);
+static void stopParallelScan(ParallelScan *scan, RC status);
 
 
 RC initRecordManager(void *mgmtData) {
@@ -44,7 +137,50 @@ void handleCleanup(BM_BufferPool *bufferPool, BM_PageHandle *pageHandle, TableMa
     }
 }
 
+// tables attach to the shared buffer pool when one is up, else get a private
+// one; without options that is 3 FIFO frames
+RC initTableBufferPool(BM_BufferPool *bufferPool, char *name, RM_TableOptions *options) {
+    bool shared = isSharedBufferPoolActive();
+    RC poolStatus;
+
+    if (options == NULL) {
+        return shared ? attachBufferPool(bufferPool, name) : initBufferPool(bufferPool, name, 3, RS_FIFO, NULL);
+    }
+    // an update pins the record's page and the page its body moves to; the
+    // buffer manager can only evict with FIFO and LRU replacement
+    if (options->poolSize < 2 || options->prefetchDepth < 0) {
+        return RC_ERROR;
+    }
+    if (options->strategy != RS_FIFO && options->strategy != RS_LRU) {
+        return RC_ERROR;
+    }
+    // size, strategy and writer of the shared pool are set by whoever started it
+    if (shared) {
+        poolStatus = attachBufferPool(bufferPool, name);
+    } else {
+        poolStatus = initBufferPool(bufferPool, name, options->poolSize, options->strategy, NULL);
+    }
+    if (poolStatus != RC_OK) {
+        return poolStatus;
+    }
+
+    poolStatus = setReadAheadDepth(bufferPool, options->prefetchDepth);
+    if (poolStatus == RC_OK && !shared && options->writeBack == RM_WRITE_BACK_BACKGROUND) {
+        int lowWatermark = options->poolSize / 8 > 0 ? options->poolSize / 8 : 1;
+        int highWatermark = options->poolSize / 4 > lowWatermark ? options->poolSize / 4 : lowWatermark;
+        poolStatus = startBackgroundWriter(bufferPool, lowWatermark, highWatermark);
+    }
+    if (poolStatus != RC_OK) {
+        shutdownBufferPool(bufferPool);
+    }
+    return poolStatus;
+}
+
 RC createTable(char *name, Schema *schema) {
+    return createTableWithLayout(name, schema, RM_LAYOUT_ROW);
+}
+
+RC createTableWithLayout(char *name, Schema *schema, RM_PageLayout layout) {
     if (name == NULL || schema == NULL) return RC_GENERAL_ERROR;
 
     BM_BufferPool *bufferPool = calloc(1, sizeof(BM_BufferPool));
@@ -69,7 +205,7 @@ RC createTable(char *name, Schema *schema) {
         return result;
     }
 
-    result = initBufferPool(bufferPool, name, 3, RS_FIFO, NULL);
+    result = initTableBufferPool(bufferPool, name, NULL);
     if (result != RC_OK) {
         handleCleanup(bufferPool, pageHandle, tableManager);
         return result;
@@ -82,6 +218,7 @@ RC createTable(char *name, Schema *schema) {
     }
 
     char *tableHeaderPtr = pageHandle->data;
+    tableManager->layout = layout;
     prepareTableHeader(&tableHeaderPtr, tableManager, schema);
 
     result = markDirty(bufferPool, pageHandle);
@@ -110,15 +247,20 @@ void prepareTableHeader(char **tableHeaderPtr, TableManager *tableManager, Schem
     
     tableManager->totalTuples = 0;
     tableManager->recSize = getRecordSize(schema);
-    tableManager->firstFreePageNum = 1;
+    tableManager->firstFreePageNum = -1;
     tableManager->firstFreeSlotNum = 0;
     tableManager->firstDataPageNum = -1;
+    tableManager->lastDataPageNum = 0;
 
+    *headerInt++ = TABLE_HEADER_MAGIC;
+    *headerInt++ = TABLE_FORMAT_VERSION;
     *headerInt++ = tableManager->totalTuples;
     *headerInt++ = tableManager->recSize;
     *headerInt++ = tableManager->firstFreePageNum;
     *headerInt++ = tableManager->firstFreeSlotNum;
     *headerInt++ = tableManager->firstDataPageNum;
+    *headerInt++ = tableManager->lastDataPageNum;
+    *headerInt++ = tableManager->layout;
     *headerInt++ = schema->numAttr;
     *headerInt++ = schema->keySize;
 
@@ -149,6 +291,10 @@ void populateSchemaDetails(char **tableHeaderPtr, Schema *schema) {
 }
 
 RC openTable(RM_TableData *rel, char *name) {
+    return openTableWithOptions(rel, name, NULL);
+}
+
+RC openTableWithOptions(RM_TableData *rel, char *name, RM_TableOptions *options) {
     RC resultCode;
     int attributeIndex;
     TableManager *tableManager = calloc(1, sizeof(TableManager));
@@ -162,7 +308,7 @@ RC openTable(RM_TableData *rel, char *name) {
     return RC_MEMORY_ALLOCATION_FAIL;
     }
 
-    resultCode = initBufferPool(bufferManager, name, 3, RS_FIFO, NULL);
+    resultCode = initTableBufferPool(bufferManager, name, options);
     if (resultCode != RC_OK) {
         goto CLEANUP;
     return resultCode;
@@ -183,11 +329,21 @@ RC openTable(RM_TableData *rel, char *name) {
 
     tableHeader = pageHandle->data;
 
+    if (*(int *)tableHeader != TABLE_HEADER_MAGIC || *((int *)tableHeader + 1) != TABLE_FORMAT_VERSION) {
+        unpinPage(bufferManager, pageHandle);
+        shutdownBufferPool(bufferManager);
+        resultCode = RC_TABLE_FORMAT_UNSUPPORTED;
+        goto CLEANUP;
+    }
+    tableHeader += TABLE_HEADER_PREFIX_INTS * sizeof(int);
+
     *(int *)&tableManager->totalTuples = *(int *)tableHeader; tableHeader += sizeof(int);
     *(int *)&tableManager->recSize = *(int *)tableHeader; tableHeader += sizeof(int);
     *(int *)&tableManager->firstFreePageNum = *(int *)tableHeader; tableHeader += sizeof(int);
     *(int *)&tableManager->firstFreeSlotNum = *(int *)tableHeader; tableHeader += sizeof(int);
     *(int *)&tableManager->firstDataPageNum = *(int *)tableHeader; tableHeader += sizeof(int);
+    *(int *)&tableManager->lastDataPageNum = *(int *)tableHeader; tableHeader += sizeof(int);
+    *(int *)&tableManager->layout = *(int *)tableHeader; tableHeader += sizeof(int);
 
 
     int readIntFromHeader(char **header) {
@@ -241,6 +397,7 @@ RC openTable(RM_TableData *rel, char *name) {
 
     resultCode = unpinPage(bufferManager, pageHandle);
     if (resultCode != RC_OK) {
+        freeSchema(schema);
         free(tableManager);
         free(bufferManager);
         free(pageHandle);
@@ -250,6 +407,22 @@ RC openTable(RM_TableData *rel, char *name) {
     tableManager->bufferManagerPtr = bufferManager;
     tableManager->pageHandlePtr = pageHandle;
 
+    // every directory entry once belonged to a body of at least minBodyBytes
+    int minBodyBytes;
+    computeBodyLimits(schema, &minBodyBytes, &tableManager->maxRecordBytes);
+    tableManager->maxSlotsPerPage = (PAGE_DATA_SIZE - sizeof(PageHeader)) / (sizeof(SlotEntry) + minBodyBytes);
+    if (tableManager->layout == RM_LAYOUT_PAX) {
+        resultCode = setupPaxColumns(tableManager, schema);
+        if (resultCode != RC_OK) {
+            shutdownBufferPool(bufferManager);
+            freeSchema(schema);
+            free(tableManager);
+            free(bufferManager);
+            free(pageHandle);
+            return resultCode;
+        }
+    }
+
     char* duplicatedName = strdup(name);
     rel->name = duplicatedName;
     Schema* directSchemaAssignment = schema;
@@ -263,27 +436,10 @@ RC openTable(RM_TableData *rel, char *name) {
 
 RC closeTable(RM_TableData *rel) {
     TableManager *tableManager;
-    RC pinStatus, dirtyStatus, unpinStatus, shutdownStatus;
-    int headerUpdateSuccess = 0;
+    RC headerStatus, shutdownStatus;
 
     tableManager = rel->mgmtData;
-    pinStatus = pinPage(tableManager->bufferManagerPtr, tableManager->pageHandlePtr, 0);
-
-    if (pinStatus == RC_OK) {
-        int *pageHeader = (int *)tableManager->pageHandlePtr->data;
-        
-        *pageHeader++ = tableManager->totalTuples;
-        *pageHeader++ = tableManager->recSize;
-        *pageHeader++ = tableManager->firstFreePageNum;
-        *pageHeader++ = tableManager->firstFreeSlotNum;
-        *pageHeader = tableManager->firstDataPageNum;
-
-        dirtyStatus = markDirty(tableManager->bufferManagerPtr, tableManager->pageHandlePtr);
-        unpinStatus = unpinPage(tableManager->bufferManagerPtr, tableManager->pageHandlePtr);
-        headerUpdateSuccess = 1;
-    } else {
-        headerUpdateSuccess = 0;
-    }
+    headerStatus = writeTableCounters(tableManager);
 
     shutdownStatus = shutdownBufferPool(tableManager->bufferManagerPtr);
 
@@ -300,13 +456,31 @@ RC closeTable(RM_TableData *rel) {
         free(rel->schema);
     }
 
+    free(tableManager->paxColumns);
     free(tableManager);
 
-    if (headerUpdateSuccess && shutdownStatus == RC_OK) {
-        return RC_OK;
-    } else {
-        return pinStatus != RC_OK ? pinStatus : (dirtyStatus != RC_OK ? dirtyStatus : (unpinStatus != RC_OK ? unpinStatus : shutdownStatus));
+    return headerStatus != RC_OK ? headerStatus : shutdownStatus;
+}
+
+// Helper function, stores the table's counters and free page list head in
+// the table header on page 0
+RC writeTableCounters(TableManager *tableManager) {
+    RC pinStatus = pinPage(tableManager->bufferManagerPtr, tableManager->pageHandlePtr, 0);
+    if (pinStatus != RC_OK) {
+        return pinStatus;
     }
+    int *pageHeader = (int *)tableManager->pageHandlePtr->data + TABLE_HEADER_PREFIX_INTS;
+
+    *pageHeader++ = tableManager->totalTuples;
+    *pageHeader++ = tableManager->recSize;
+    *pageHeader++ = tableManager->firstFreePageNum;
+    *pageHeader++ = tableManager->firstFreeSlotNum;
+    *pageHeader++ = tableManager->firstDataPageNum;
+    *pageHeader = tableManager->lastDataPageNum;
+
+    RC dirtyStatus = markDirty(tableManager->bufferManagerPtr, tableManager->pageHandlePtr);
+    RC unpinStatus = unpinPage(tableManager->bufferManagerPtr, tableManager->pageHandlePtr);
+    return dirtyStatus != RC_OK ? dirtyStatus : unpinStatus;
 }
 
 RC deleteTable(char *name) {
@@ -341,123 +515,180 @@ RC getNumTuples(RM_TableData *rel) {
 
 RC insertRecord(RM_TableData *rel, Record *record) {
     TableManager *tableMgmt = rel->mgmtData;
-    int slotsAvailableOnPage = (PAGE_SIZE - sizeof(PageHeader)) / (tableMgmt->recSize + 2);
-    
-    BM_PageHandle *pageHandle = tableMgmt->pageHandlePtr;
-    RC pagePinStatus = pinPage(tableMgmt->bufferManagerPtr, pageHandle, tableMgmt->firstFreePageNum);
-    if (pagePinStatus != RC_OK) {
-        return RC_ERROR;
+
+    if (tableMgmt->layout == RM_LAYOUT_PAX) {
+        return paxInsertRecords(tableMgmt, &record, 1);
     }
+    return rowInsertRecords(rel, &record, 1);
+}
 
-    char *currentPageData = pageHandle->data;
-    PageHeader *currentPageHeader = (PageHeader *)currentPageData;
+RC insertRecords(RM_TableData *rel, Record **records, int numRecords) {
+    TableManager *tableMgmt = rel->mgmtData;
+    RC insertStatus;
 
-    if (currentPageHeader->pageIdentifier != 'Y') {
-        currentPageHeader->pageIdentifier = 'Y';
-        currentPageHeader->totalTuples = 0;
-        currentPageHeader->freeSlotCnt = slotsAvailableOnPage - 1;
-        currentPageHeader->nextFreeSlotInd = 1;
-        currentPageHeader->prevFreePageIndex = -1;
-        currentPageHeader->nextFreePageIndex = pageHandle->pageNum + 1;
-        currentPageHeader->prevDataPageIndex = -1;
-        currentPageHeader->nextDataPageIndex = 1;
+    if (tableMgmt->layout == RM_LAYOUT_PAX) {
+        insertStatus = paxInsertRecords(tableMgmt, records, numRecords);
     } else {
-        currentPageHeader->totalTuples++;
-        currentPageHeader->freeSlotCnt--;
-        if (currentPageHeader->freeSlotCnt > 0) {
-            currentPageHeader->nextFreeSlotInd++;
-        } else {
-            currentPageHeader->nextFreeSlotInd = -currentPageHeader->nextFreeSlotInd;
-        }
+        insertStatus = rowInsertRecords(rel, records, numRecords);
     }
+    // one header write covers the whole batch
+    RC headerStatus = writeTableCounters(tableMgmt);
+    return insertStatus != RC_OK ? insertStatus : headerStatus;
+}
 
-    int positionForNewData = sizeof(PageHeader) + (tableMgmt->firstFreeSlotNum * (tableMgmt->recSize + 2));
-    currentPageData[positionForNewData] = 'Y';
-    memcpy(currentPageData + positionForNewData + 1, record->data, tableMgmt->recSize);
-    currentPageData[positionForNewData + tableMgmt->recSize + 1] = '|';
-
-    record->id.page = pageHandle->pageNum;
-    record->id.slot = tableMgmt->firstFreeSlotNum;
+RC getRecord(RM_TableData *rel, RID id, Record *record) {
+    TableManager *tableManager = rel->mgmtData;
 
-    if (currentPageHeader->freeSlotCnt == 0) {
-        tableMgmt->firstFreePageNum++;
-        tableMgmt->firstFreeSlotNum = 0;
-    } else {
-        tableMgmt->firstFreeSlotNum++;
+    // page 0 holds the table header
+    if (id.page < 1 || id.slot < 0 || id.slot >= tableManager->maxSlotsPerPage) {
+        return RC_RECORD_NOT_FOUND;
+    }
+    if (tableManager->layout == RM_LAYOUT_PAX) {
+        return paxGetRecord(tableManager, id, record);
     }
 
-    tableMgmt->totalTuples++;
-
-    RC dirtyStatus = markDirty(tableMgmt->bufferManagerPtr, pageHandle);
-    RC unpinStatus = unpinPage(tableMgmt->bufferManagerPtr, pageHandle);
-    if (dirtyStatus != RC_OK || unpinStatus != RC_OK) {
+    BM_PageHandle *pageHandler = tableManager->pageHandlePtr;
+    RC pinPageStatus = pinPage(tableManager->bufferManagerPtr, pageHandler, id.page);
+    if (pinPageStatus != RC_OK) {
         return RC_ERROR;
     }
 
-    return RC_OK;
+    RC readStatus = readRowSlot(rel, pageHandler->data, id.slot, record->data, NULL, FALSE);
+    if (readStatus == RC_OK) {
+        record->id = id;
+    }
+
+    RC unpinPageStatus = unpinPage(tableManager->bufferManagerPtr, pageHandler);
+    return readStatus != RC_OK ? readStatus : unpinPageStatus;
 }
 
-RC getRecord(RM_TableData *rel, RID id, Record *record) {
+RC getRecordRef(RM_TableData *rel, RID id, RecordRef *ref) {
     TableManager *tableManager = rel->mgmtData;
-    int slotsPerRecord = (PAGE_SIZE - sizeof(PageHeader)) / (tableManager->recSize + 2);
+    BM_PageHandle *page = &ref->page;
 
-    if (id.slot >= slotsPerRecord) {
+    if (id.page < 1 || id.slot < 0 || id.slot >= tableManager->maxSlotsPerPage) {
         return RC_RECORD_NOT_FOUND;
     }
-
-    BM_PageHandle *pageHandler = tableManager->pageHandlePtr;
-    RC pinPageStatus = pinPage(tableManager->bufferManagerPtr, pageHandler, id.page);
-    if (pinPageStatus != RC_OK) {
+    if (pinPage(tableManager->bufferManagerPtr, page, id.page) != RC_OK) {
         return RC_ERROR;
     }
+    ref->rel = rel;
+    ref->id = id;
+    ref->body = NULL;
+    ref->length = 0;
+
+    if (tableManager->layout == RM_LAYOUT_PAX) {
+        // values are read straight from the minipages
+        if (((PageHeader *)page->data)->pageIdentifier != 'Y' || page->data[sizeof(PageHeader) + id.slot] == 0) {
+            unpinPage(tableManager->bufferManagerPtr, page);
+            return RC_RECORD_NOT_FOUND;
+        }
+        return RC_OK;
+    }
 
-    char *recordLocation = pageHandler->data + sizeof(PageHeader) + (id.slot * (tableManager->recSize + 2));
-    if (*recordLocation != 'Y') {
-        unpinPage(tableManager->bufferManagerPtr, pageHandler);
+    SlotEntry *entry = findRecordSlot(page->data, id.slot);
+    if (entry == NULL) {
+        unpinPage(tableManager->bufferManagerPtr, page);
         return RC_RECORD_NOT_FOUND;
     }
+    if (entry->length & SLOT_FORWARDED) {
+        // the ref pins the page the body moved to instead of the stub's
+        RID target;
+        memcpy(&target, page->data + entry->offset, sizeof(RID));
+        unpinPage(tableManager->bufferManagerPtr, page);
+        if (pinPage(tableManager->bufferManagerPtr, page, target.page) != RC_OK) {
+            return RC_ERROR;
+        }
+        entry = slotDirectory(page->data) + target.slot;
+    }
+    ref->body = page->data + entry->offset;
+    ref->length = entry->length & SLOT_LENGTH_MASK;
+    return RC_OK;
+}
 
-    char *recordDataStart = recordLocation + 1;
-    memcpy(record->data, recordDataStart, tableManager->recSize);
-    record->id = id;
+RC releaseRecordRef(RecordRef *ref) {
+    if (!ref || !ref->rel) return RC_RECORD_NOT_FOUND;
 
-    RC unpinPageStatus = unpinPage(tableManager->bufferManagerPtr, pageHandler);
-    return unpinPageStatus;
+    TableManager *tableManager = ref->rel->mgmtData;
+    RC unpinStatus = unpinPage(tableManager->bufferManagerPtr, &ref->page);
+    ref->rel = NULL;
+    ref->body = NULL;
+    return unpinStatus;
 }
 
-
 RC updateRecord(RM_TableData *rel, Record *record) {
     TableManager *tableManager = (TableManager *)rel->mgmtData;
-    int maxSlotsPerRecord = (PAGE_SIZE - sizeof(PageHeader)) / (tableManager->recSize + 2);
+    RID id = record->id;
+    char body[PAGE_SIZE];
 
-    if (record->id.slot >= maxSlotsPerRecord) {
+    if (id.page < 1 || id.slot < 0 || id.slot >= tableManager->maxSlotsPerPage) {
         return RC_RECORD_NOT_FOUND;
     }
+    if (tableManager->layout == RM_LAYOUT_PAX) {
+        return paxUpdateRecord(tableManager, record);
+    }
 
     BM_PageHandle *pageHandle = tableManager->pageHandlePtr;
-    RC pinResult = pinPage(tableManager->bufferManagerPtr, pageHandle, record->id.page);
+    RC pinResult = pinPage(tableManager->bufferManagerPtr, pageHandle, id.page);
     if (pinResult != RC_OK) {
         return RC_ERROR;
     }
 
-    char *targetSlot = pageHandle->data + sizeof(PageHeader) + (record->id.slot * (tableManager->recSize + 2));
-    if (*targetSlot != 'Y') {
+    SlotEntry *entry = findRecordSlot(pageHandle->data, id.slot);
+    if (entry == NULL) {
         unpinPage(tableManager->bufferManagerPtr, pageHandle);
         return RC_RECORD_NOT_FOUND;
     }
 
-    memcpy(targetSlot + 1, record->data, tableManager->recSize);
+    int bodyLength = encodeRecord(rel->schema, record->data, body);
+    RC result = RC_OK;
+
+    if (entry->length & SLOT_FORWARDED) {
+        RID target;
+        BM_PageHandle targetHandle;
+        memcpy(&target, pageHandle->data + entry->offset, sizeof(RID));
+        bool outgrown = FALSE;
+        result = pinPage(tableManager->bufferManagerPtr, &targetHandle, target.page);
+        if (result == RC_OK) {
+            if (resizeSlot(targetHandle.data, target.slot, bodyLength, SLOT_MOVED)) {
+                memcpy(targetHandle.data + slotDirectory(targetHandle.data)[target.slot].offset, body, bodyLength);
+                noteFreeSpace(tableManager, targetHandle.data, target.page);
+            } else {
+                releaseSlot(tableManager, targetHandle.data, target.page, target.slot);
+                outgrown = TRUE;
+            }
+            markDirty(tableManager->bufferManagerPtr, &targetHandle);
+            unpinPage(tableManager->bufferManagerPtr, &targetHandle);
+        }
+        if (outgrown) {
+            // the body outgrew the page it was moved to as well, move it once more
+            result = placeRecordBody(tableManager, body, bodyLength, SLOT_MOVED, &target);
+            if (result == RC_OK) {
+                memcpy(pageHandle->data + entry->offset, &target, sizeof(RID));
+            }
+        }
+    } else if (resizeSlot(pageHandle->data, id.slot, bodyLength, 0)) {
+        memcpy(pageHandle->data + entry->offset, body, bodyLength);
+        noteFreeSpace(tableManager, pageHandle->data, id.page);
+    } else {
+        // no room left on this page: move the body and leave a forwarding stub
+        RID target;
+        result = placeRecordBody(tableManager, body, bodyLength, SLOT_MOVED, &target);
+        if (result == RC_OK) {
+            resizeSlot(pageHandle->data, id.slot, sizeof(RID), SLOT_FORWARDED);
+            memcpy(pageHandle->data + entry->offset, &target, sizeof(RID));
+            noteFreeSpace(tableManager, pageHandle->data, id.page);
+        }
+    }
 
     RC dirtyFlag = markDirty(tableManager->bufferManagerPtr, pageHandle);
     RC unpinFlag = unpinPage(tableManager->bufferManagerPtr, pageHandle);
 
+    if (result != RC_OK) {
+        return result;
+    }
     if (dirtyFlag != RC_OK || unpinFlag != RC_OK) {
-        if (dirtyFlag != RC_OK) {
-            return RC_ERROR;
-        }
-        if (unpinFlag != RC_OK) {
-            return RC_ERROR;
-        }
+        return RC_ERROR;
     }
 
     return RC_OK;
@@ -466,11 +697,13 @@ RC updateRecord(RM_TableData *rel, Record *record) {
 
 RC deleteRecord(RM_TableData *rel, RID id) {
     TableManager *tableMgmt = (TableManager *)rel->mgmtData;
-    int maximumSlotsPerPage = (PAGE_SIZE - sizeof(PageHeader)) / (tableMgmt->recSize + 2);
 
-    if (id.slot >= maximumSlotsPerPage) {
+    if (id.page < 1 || id.slot < 0 || id.slot >= tableMgmt->maxSlotsPerPage) {
         return RC_RECORD_NOT_FOUND;
     }
+    if (tableMgmt->layout == RM_LAYOUT_PAX) {
+        return paxDeleteRecord(tableMgmt, id);
+    }
 
     BM_PageHandle *pageHandle = tableMgmt->pageHandlePtr;
     RC pinStatus = pinPage(tableMgmt->bufferManagerPtr, pageHandle, id.page);
@@ -478,20 +711,23 @@ RC deleteRecord(RM_TableData *rel, RID id) {
         return pinStatus; 
     }
 
-    int recordPosition = sizeof(PageHeader) + (id.slot * (tableMgmt->recSize + 2));
-    char *recordIndicator = &pageHandle->data[recordPosition];
-    if (*recordIndicator != 'Y') { 
+    SlotEntry *entry = findRecordSlot(pageHandle->data, id.slot);
+    if (entry == NULL) {
         unpinPage(tableMgmt->bufferManagerPtr, pageHandle);
         return RC_RECORD_NOT_FOUND;
     }
 
-    *recordIndicator = 'N'; 
-    PageHeader *header = (PageHeader *)pageHandle->data;
-    header->totalTuples = header->totalTuples > 0 ? header->totalTuples - 1 : 0;
-    header->freeSlotCnt += 1;
-
-    memcpy(pageHandle->data + recordPosition, recordIndicator, 1);
-    memcpy(pageHandle->data, header, sizeof(PageHeader));
+    if (entry->length & SLOT_FORWARDED) {
+        RID target;
+        BM_PageHandle targetHandle;
+        memcpy(&target, pageHandle->data + entry->offset, sizeof(RID));
+        if (pinPage(tableMgmt->bufferManagerPtr, &targetHandle, target.page) == RC_OK) {
+            releaseSlot(tableMgmt, targetHandle.data, target.page, target.slot);
+            markDirty(tableMgmt->bufferManagerPtr, &targetHandle);
+            unpinPage(tableMgmt->bufferManagerPtr, &targetHandle);
+        }
+    }
+    releaseSlot(tableMgmt, pageHandle->data, id.page, id.slot);
 
     tableMgmt->totalTuples = tableMgmt->totalTuples > 0 ? tableMgmt->totalTuples - 1 : 0;
 
@@ -508,6 +744,625 @@ RC deleteRecord(RM_TableData *rel, RID id) {
     return RC_OK;
 }
 
+// Helper function, the slot directory starts right behind the page header
+SlotEntry *slotDirectory(char *pageData) {
+    return (SlotEntry *)(pageData + sizeof(PageHeader));
+}
+
+// Helper function, the directory entry of a record the caller may address,
+// NULL for free slots and for bodies moved here from another page
+SlotEntry *findRecordSlot(char *pageData, int slot) {
+    PageHeader *header = (PageHeader *)pageData;
+    if (header->pageIdentifier != 'Y' || slot >= header->numSlots) {
+        return NULL;
+    }
+    SlotEntry *entry = slotDirectory(pageData) + slot;
+    if ((entry->length & SLOT_LENGTH_MASK) == 0 || (entry->length & SLOT_MOVED)) {
+        return NULL;
+    }
+    return entry;
+}
+
+// Helper function, decodes the record in a slot of a pinned row page,
+// following a forwarding stub to the page its body moved to; waitForFrame
+// pins that page with pinPageWait
+RC readRowSlot(RM_TableData *rel, char *pageData, int slot, char *data, const bool *attrMask, bool waitForFrame) {
+    TableManager *tableManager = rel->mgmtData;
+    SlotEntry *entry = findRecordSlot(pageData, slot);
+    if (entry == NULL) {
+        return RC_RECORD_NOT_FOUND;
+    }
+    if (!(entry->length & SLOT_FORWARDED)) {
+        decodeRecord(rel->schema, pageData + entry->offset, data, tableManager->recSize, attrMask);
+        return RC_OK;
+    }
+    BM_PageHandle targetHandle;
+    RID target;
+    memcpy(&target, pageData + entry->offset, sizeof(RID));
+    BM_BufferPool *bufferPool = tableManager->bufferManagerPtr;
+    RC pinStatus = waitForFrame ? pinPageWait(bufferPool, &targetHandle, target.page)
+                                : pinPage(bufferPool, &targetHandle, target.page);
+    if (pinStatus != RC_OK) {
+        return RC_ERROR;
+    }
+    SlotEntry *targetEntry = slotDirectory(targetHandle.data) + target.slot;
+    decodeRecord(rel->schema, targetHandle.data + targetEntry->offset, data, tableManager->recSize, attrMask);
+    return unpinPage(tableManager->bufferManagerPtr, &targetHandle);
+}
+
+// Helper function, formats a fresh data page with an empty slot directory
+void initDataPage(char *pageData) {
+    PageHeader *header = (PageHeader *)pageData;
+    header->pageIdentifier = 'Y';
+    header->totalTuples = 0;
+    header->freeSlotCnt = 0;
+    header->nextFreeSlotInd = -1;
+    header->prevFreePageIndex = -1;
+    header->nextFreePageIndex = -1;
+    header->prevDataPageIndex = -1;
+    header->nextDataPageIndex = -1;
+    header->numSlots = 0;
+    header->recordsStart = PAGE_DATA_SIZE;
+    header->freeBytes = PAGE_DATA_SIZE - sizeof(PageHeader);
+    header->onFreeList = FALSE;
+}
+
+// Helper function, packs the record bodies against the end of the page so
+// all free space forms one gap between them and the slot directory
+void compactPage(char *pageData) {
+    PageHeader *header = (PageHeader *)pageData;
+    SlotEntry *directory = slotDirectory(pageData);
+    char packed[PAGE_SIZE];
+    int end = PAGE_DATA_SIZE;
+    for (int slot = 0; slot < header->numSlots; slot++) {
+        int length = directory[slot].length & SLOT_LENGTH_MASK;
+        if (length == 0) {
+            continue;
+        }
+        end -= length;
+        memcpy(packed + end, pageData + directory[slot].offset, length);
+        directory[slot].offset = end;
+    }
+    memcpy(pageData + end, packed + end, PAGE_DATA_SIZE - end);
+    header->recordsStart = end;
+}
+
+// Helper function, takes a directory entry and length bytes of body space;
+// the caller made sure freeBytes covers both
+int allocSlot(char *pageData, int length) {
+    PageHeader *header = (PageHeader *)pageData;
+    SlotEntry *directory = slotDirectory(pageData);
+    int slot = header->nextFreeSlotInd;
+    int needed = length + (slot == -1 ? sizeof(SlotEntry) : 0);
+    int gap = header->recordsStart - (int)(sizeof(PageHeader) + header->numSlots * sizeof(SlotEntry));
+    if (gap < needed) {
+        compactPage(pageData);
+    }
+    if (slot == -1) {
+        slot = header->numSlots++;
+    } else {
+        header->nextFreeSlotInd = directory[slot].offset == NO_FREE_SLOT ? -1 : directory[slot].offset;
+        header->freeSlotCnt--;
+    }
+    header->recordsStart -= length;
+    directory[slot].offset = header->recordsStart;
+    directory[slot].length = length;
+    header->freeBytes -= needed;
+    return slot;
+}
+
+// Helper function, gives a slot's body a new length, in place when it shrinks
+// and elsewhere on the page when it grows; FALSE when the page has no room
+bool resizeSlot(char *pageData, int slot, int length, int flags) {
+    PageHeader *header = (PageHeader *)pageData;
+    SlotEntry *entry = slotDirectory(pageData) + slot;
+    int oldLength = entry->length & SLOT_LENGTH_MASK;
+    if (length > oldLength) {
+        if (header->freeBytes + oldLength < length) {
+            return FALSE;
+        }
+        entry->length = 0;
+        header->freeBytes += oldLength;
+        int gap = header->recordsStart - (int)(sizeof(PageHeader) + header->numSlots * sizeof(SlotEntry));
+        if (gap < length) {
+            compactPage(pageData);
+        }
+        header->recordsStart -= length;
+        entry->offset = header->recordsStart;
+        header->freeBytes -= length;
+    } else {
+        // the tail of the old body is reclaimed by the next compaction
+        header->freeBytes += oldLength - length;
+    }
+    entry->length = length | flags;
+    return TRUE;
+}
+
+// Helper function, frees a slot's body and puts its entry on the free chain
+void releaseSlot(TableManager *tableMgmt, char *pageData, int pageNum, int slot) {
+    PageHeader *header = (PageHeader *)pageData;
+    SlotEntry *entry = slotDirectory(pageData) + slot;
+    if (!(entry->length & SLOT_MOVED)) {
+        header->totalTuples = header->totalTuples > 0 ? header->totalTuples - 1 : 0;
+    }
+    header->freeBytes += entry->length & SLOT_LENGTH_MASK;
+    entry->length = 0;
+    entry->offset = header->nextFreeSlotInd == -1 ? NO_FREE_SLOT : header->nextFreeSlotInd;
+    header->nextFreeSlotInd = slot;
+    header->freeSlotCnt++;
+    noteFreeSpace(tableMgmt, pageData, pageNum);
+}
+
+// Helper function, puts a page that has room for any record again back on
+// the free page list. Less room than the largest record and its slot stays
+// unused until more is freed, which bounds what short records waste per page
+void noteFreeSpace(TableManager *tableMgmt, char *pageData, int pageNum) {
+    PageHeader *header = (PageHeader *)pageData;
+    if (!header->onFreeList && header->freeBytes >= tableMgmt->maxRecordBytes + (int)sizeof(SlotEntry)) {
+        header->nextFreePageIndex = tableMgmt->firstFreePageNum;
+        header->onFreeList = TRUE;
+        tableMgmt->firstFreePageNum = pageNum;
+    }
+}
+
+// Helper function, stores a record body on the head of the free page list,
+// appending a page when the list is empty. Pages whose room was used up by
+// growing updates are dropped from the list as they come up
+RC placeRecordBody(TableManager *tableMgmt, const char *body, int length, int flags, RID *id) {
+    BM_PageHandle pageHandle;
+
+    if (pinInsertPage(tableMgmt, &pageHandle, length) != RC_OK) {
+        return RC_ERROR;
+    }
+    PageHeader *header = (PageHeader *)pageHandle.data;
+    int slot = allocSlot(pageHandle.data, length);
+    SlotEntry *entry = slotDirectory(pageHandle.data) + slot;
+    memcpy(pageHandle.data + entry->offset, body, length);
+    entry->length |= flags;
+    if (!(flags & SLOT_MOVED)) {
+        header->totalTuples++;
+    }
+    leaveFreeListIfFull(tableMgmt, header);
+
+    id->page = pageHandle.pageNum;
+    id->slot = slot;
+
+    RC dirtyStatus = markDirty(tableMgmt->bufferManagerPtr, &pageHandle);
+    RC unpinStatus = unpinPage(tableMgmt->bufferManagerPtr, &pageHandle);
+    if (dirtyStatus != RC_OK || unpinStatus != RC_OK) {
+        return RC_ERROR;
+    }
+    return RC_OK;
+}
+
+// Helper function, pins the head of the free page list, or a new page behind
+// the last data page when the list is empty, dropping pages from the list
+// until one has room for a body of length bytes
+RC pinInsertPage(TableManager *tableMgmt, BM_PageHandle *pageHandle, int length) {
+    for (;;) {
+        int targetPageNum = tableMgmt->firstFreePageNum;
+        if (targetPageNum == -1) {
+            targetPageNum = tableMgmt->lastDataPageNum + 1;
+        }
+        if (pinPage(tableMgmt->bufferManagerPtr, pageHandle, targetPageNum) != RC_OK) {
+            return RC_ERROR;
+        }
+        PageHeader *header = (PageHeader *)pageHandle->data;
+        if (header->pageIdentifier != 'Y') {
+            initDataPage(pageHandle->data);
+            header->onFreeList = TRUE;
+            tableMgmt->firstFreePageNum = targetPageNum;
+            if (targetPageNum > tableMgmt->lastDataPageNum) {
+                tableMgmt->lastDataPageNum = targetPageNum;
+            }
+        }
+        if (bodyFits(header, length)) {
+            return RC_OK;
+        }
+        tableMgmt->firstFreePageNum = header->nextFreePageIndex;
+        header->nextFreePageIndex = -1;
+        header->onFreeList = FALSE;
+        markDirty(tableMgmt->bufferManagerPtr, pageHandle);
+        unpinPage(tableMgmt->bufferManagerPtr, pageHandle);
+    }
+}
+
+// Helper function, whether a body of length bytes and its slot fit the page
+bool bodyFits(PageHeader *header, int length) {
+    return header->freeBytes >= length + (header->nextFreeSlotInd == -1 ? (int)sizeof(SlotEntry) : 0);
+}
+
+// Helper function, inserts records into row pages, filling each page it pins
+// as far as the records fit before moving on
+RC rowInsertRecords(RM_TableData *rel, Record **records, int numRecords) {
+    TableManager *tableMgmt = rel->mgmtData;
+    BM_PageHandle pageHandle;
+    char body[PAGE_SIZE];
+    int next = 0;
+
+    if (numRecords <= 0) {
+        return RC_OK;
+    }
+    int bodyLength = encodeRecord(rel->schema, records[0]->data, body);
+    while (next < numRecords) {
+        if (pinInsertPage(tableMgmt, &pageHandle, bodyLength) != RC_OK) {
+            return RC_ERROR;
+        }
+        PageHeader *header = (PageHeader *)pageHandle.data;
+        int first = next;
+        do {
+            int slot = allocSlot(pageHandle.data, bodyLength);
+            SlotEntry *entry = slotDirectory(pageHandle.data) + slot;
+            memcpy(pageHandle.data + entry->offset, body, bodyLength);
+            records[next]->id.page = pageHandle.pageNum;
+            records[next]->id.slot = slot;
+            if (++next < numRecords) {
+                bodyLength = encodeRecord(rel->schema, records[next]->data, body);
+            }
+        } while (next < numRecords && bodyFits(header, bodyLength));
+
+        header->totalTuples += next - first;
+        tableMgmt->totalTuples += next - first;
+        leaveFreeListIfFull(tableMgmt, header);
+        RC dirtyStatus = markDirty(tableMgmt->bufferManagerPtr, &pageHandle);
+        RC unpinStatus = unpinPage(tableMgmt->bufferManagerPtr, &pageHandle);
+        if (dirtyStatus != RC_OK || unpinStatus != RC_OK) {
+            return RC_ERROR;
+        }
+    }
+    return RC_OK;
+}
+
+// Helper function, a page at the head of the free page list that cannot take
+// the largest record leaves the list
+void leaveFreeListIfFull(TableManager *tableMgmt, PageHeader *header) {
+    if (header->freeBytes < tableMgmt->maxRecordBytes + (int)sizeof(SlotEntry)) {
+        tableMgmt->firstFreePageNum = header->nextFreePageIndex;
+        header->nextFreePageIndex = -1;
+        header->onFreeList = FALSE;
+    }
+}
+
+// Helper function, the on-page form of a record: strings are stored at their
+// actual length behind a two byte length, everything else as in the record
+int encodeRecord(Schema *schema, const char *data, char *body) {
+    int length = 0;
+    for (int i = 0; i < schema->numAttr; i++) {
+        const char *attr = data + getAttrPos(schema, i);
+        if (schema->dataTypes[i] == DT_STRING) {
+            uint16_t stringLength = strnlen(attr, schema->typeLength[i]);
+            memcpy(body + length, &stringLength, sizeof(stringLength));
+            memcpy(body + length + sizeof(stringLength), attr, stringLength);
+            length += sizeof(stringLength) + stringLength;
+        } else {
+            int size = attrStoredSize(schema, i);
+            memcpy(body + length, attr, size);
+            length += size;
+        }
+    }
+    // every body can later turn into a forwarding stub in place
+    while (length < (int)sizeof(RID)) {
+        body[length++] = 0;
+    }
+    return length;
+}
+
+// Helper function, the inverse of encodeRecord; with an attrMask only the
+// attributes it flags are written to data, the others are stepped over
+void decodeRecord(Schema *schema, const char *body, char *data, int recSize, const bool *attrMask) {
+    if (attrMask == NULL) {
+        memset(data, 0, recSize);
+    }
+    for (int i = 0; i < schema->numAttr; i++) {
+        char *attr = data + getAttrPos(schema, i);
+        bool wanted = attrMask == NULL || attrMask[i];
+        if (schema->dataTypes[i] == DT_STRING) {
+            uint16_t stringLength;
+            memcpy(&stringLength, body, sizeof(stringLength));
+            if (wanted) {
+                memcpy(attr, body + sizeof(stringLength), stringLength);
+                memset(attr + stringLength, 0, schema->typeLength[i] - stringLength);
+            }
+            body += sizeof(stringLength) + stringLength;
+        } else {
+            int size = attrStoredSize(schema, i);
+            if (wanted) {
+                memcpy(attr, body, size);
+            }
+            body += size;
+        }
+    }
+}
+
+// Helper function, bytes a non-string attribute takes in a record
+int attrStoredSize(Schema *schema, int attrNum) {
+    switch (schema->dataTypes[attrNum]) {
+        case DT_INT:
+            return sizeof(int);
+        case DT_FLOAT:
+            return sizeof(float);
+        case DT_BOOL:
+            return sizeof(bool);
+        default:
+            return schema->typeLength[attrNum];
+    }
+}
+
+// Helper function, the body sizes records of a schema can take on a page
+void computeBodyLimits(Schema *schema, int *minBytes, int *maxBytes) {
+    *minBytes = 0;
+    *maxBytes = 0;
+    for (int i = 0; i < schema->numAttr; i++) {
+        if (schema->dataTypes[i] == DT_STRING) {
+            *minBytes += sizeof(uint16_t);
+            *maxBytes += sizeof(uint16_t) + schema->typeLength[i];
+        } else {
+            *minBytes += attrStoredSize(schema, i);
+            *maxBytes += attrStoredSize(schema, i);
+        }
+    }
+    if (*minBytes < (int)sizeof(RID)) {
+        *minBytes = sizeof(RID);
+    }
+    if (*maxBytes < (int)sizeof(RID)) {
+        *maxBytes = sizeof(RID);
+    }
+}
+
+// Helper function, places every attribute's minipage on a PAX page; the
+// slots a page holds follow from one presence byte plus one record per slot
+RC setupPaxColumns(TableManager *tableManager, Schema *schema) {
+    int slotsPerPage = (PAGE_DATA_SIZE - sizeof(PageHeader) - sizeof(int)) / (tableManager->recSize + 1);
+    int base = sizeof(PageHeader) + slotsPerPage;
+    base = (base + sizeof(int) - 1) / sizeof(int) * sizeof(int);
+
+    tableManager->paxColumns = calloc(schema->numAttr, sizeof(PaxColumn));
+    if (tableManager->paxColumns == NULL) {
+        return RC_MEMORY_ALLOCATION_FAIL;
+    }
+    for (int i = 0; i < schema->numAttr; i++) {
+        PaxColumn *column = &tableManager->paxColumns[i];
+        column->recordOffset = getAttrPos(schema, i);
+        column->pageOffset = base + slotsPerPage * column->recordOffset;
+        column->size = attrStoredSize(schema, i);
+    }
+    tableManager->paxColumnCount = schema->numAttr;
+    tableManager->maxSlotsPerPage = slotsPerPage;
+    return RC_OK;
+}
+
+// Helper function, formats a fresh PAX page with every slot free; nextFreeSlotInd
+// is the lowest slot that may be free
+void initPaxPage(char *pageData, int slotsPerPage) {
+    PageHeader *header = (PageHeader *)pageData;
+    header->pageIdentifier = 'Y';
+    header->totalTuples = 0;
+    header->freeSlotCnt = slotsPerPage;
+    header->nextFreeSlotInd = 0;
+    header->prevFreePageIndex = -1;
+    header->nextFreePageIndex = -1;
+    header->prevDataPageIndex = -1;
+    header->nextDataPageIndex = -1;
+    header->numSlots = slotsPerPage;
+    header->recordsStart = PAGE_DATA_SIZE;
+    header->freeBytes = 0;
+    header->onFreeList = FALSE;
+    memset(pageData + sizeof(PageHeader), 0, slotsPerPage);
+}
+
+// Helper function, inserts records into PAX pages: the free slots of a page
+// are claimed for a run of records, which is then copied in column by column
+RC paxInsertRecords(TableManager *tableMgmt, Record **records, int numRecords) {
+    BM_PageHandle *pageHandle = tableMgmt->pageHandlePtr;
+    int slotsPerPage = tableMgmt->maxSlotsPerPage;
+    int next = 0;
+
+    while (next < numRecords) {
+        // a PAX page is on the free page list exactly while it has a free slot
+        int targetPageNum = tableMgmt->firstFreePageNum;
+        if (targetPageNum == -1) {
+            targetPageNum = tableMgmt->lastDataPageNum + 1;
+        }
+        if (pinPage(tableMgmt->bufferManagerPtr, pageHandle, targetPageNum) != RC_OK) {
+            return RC_ERROR;
+        }
+
+        char *pageData = pageHandle->data;
+        PageHeader *header = (PageHeader *)pageData;
+        if (header->pageIdentifier != 'Y') {
+            initPaxPage(pageData, slotsPerPage);
+            header->onFreeList = TRUE;
+            tableMgmt->firstFreePageNum = targetPageNum;
+            if (targetPageNum > tableMgmt->lastDataPageNum) {
+                tableMgmt->lastDataPageNum = targetPageNum;
+            }
+        }
+
+        char *presence = pageData + sizeof(PageHeader);
+        int first = next;
+        while (next < numRecords && header->freeSlotCnt > 0) {
+            char *freeSlot = memchr(presence + header->nextFreeSlotInd, 0, slotsPerPage - header->nextFreeSlotInd);
+            int slot = freeSlot - presence;
+            presence[slot] = 1;
+            header->nextFreeSlotInd = slot + 1;
+            header->freeSlotCnt--;
+            records[next]->id.page = targetPageNum;
+            records[next]->id.slot = slot;
+            next++;
+        }
+        for (int i = 0; i < tableMgmt->paxColumnCount; i++) {
+            PaxColumn *column = &tableMgmt->paxColumns[i];
+            for (int r = first; r < next; r++) {
+                memcpy(pageData + column->pageOffset + records[r]->id.slot * column->size,
+                       records[r]->data + column->recordOffset, column->size);
+            }
+        }
+        header->totalTuples += next - first;
+        tableMgmt->totalTuples += next - first;
+
+        if (header->freeSlotCnt == 0) {
+            tableMgmt->firstFreePageNum = header->nextFreePageIndex;
+            header->nextFreePageIndex = -1;
+            header->onFreeList = FALSE;
+        }
+
+        RC dirtyStatus = markDirty(tableMgmt->bufferManagerPtr, pageHandle);
+        RC unpinStatus = unpinPage(tableMgmt->bufferManagerPtr, pageHandle);
+        if (dirtyStatus != RC_OK || unpinStatus != RC_OK) {
+            return RC_ERROR;
+        }
+    }
+    return RC_OK;
+}
+
+RC paxGetRecord(TableManager *tableMgmt, RID id, Record *record) {
+    BM_PageHandle *pageHandle = tableMgmt->pageHandlePtr;
+    if (pinPage(tableMgmt->bufferManagerPtr, pageHandle, id.page) != RC_OK) {
+        return RC_ERROR;
+    }
+
+    char *pageData = pageHandle->data;
+    if (((PageHeader *)pageData)->pageIdentifier != 'Y' || pageData[sizeof(PageHeader) + id.slot] == 0) {
+        unpinPage(tableMgmt->bufferManagerPtr, pageHandle);
+        return RC_RECORD_NOT_FOUND;
+    }
+    paxGather(tableMgmt, pageData, id.slot, record->data, -1, FALSE);
+    record->id = id;
+
+    return unpinPage(tableMgmt->bufferManagerPtr, pageHandle);
+}
+
+// Helper function, copies a slot's values from the minipages into record
+// data: only attribute attrNum when onlyAttr is set, else every attribute but
+// attrNum (-1 for all of them)
+void paxGather(TableManager *tableMgmt, char *pageData, int slot, char *data, int attrNum, bool onlyAttr) {
+    for (int i = 0; i < tableMgmt->paxColumnCount; i++) {
+        if ((i == attrNum) != onlyAttr) {
+            continue;
+        }
+        PaxColumn *column = &tableMgmt->paxColumns[i];
+        memcpy(data + column->recordOffset, pageData + column->pageOffset + slot * column->size, column->size);
+    }
+}
+
+// Helper function, gathers the attributes attrMask flags but skipAttr; every
+// attribute but skipAttr without a mask
+void paxGatherMasked(TableManager *tableMgmt, char *pageData, int slot, char *data, const bool *attrMask, int skipAttr) {
+    if (attrMask == NULL) {
+        paxGather(tableMgmt, pageData, slot, data, skipAttr, FALSE);
+        return;
+    }
+    for (int i = 0; i < tableMgmt->paxColumnCount; i++) {
+        if (attrMask[i] && i != skipAttr) {
+            paxGather(tableMgmt, pageData, slot, data, i, TRUE);
+        }
+    }
+}
+
+RC paxUpdateRecord(TableManager *tableMgmt, Record *record) {
+    BM_PageHandle *pageHandle = tableMgmt->pageHandlePtr;
+    RID id = record->id;
+    if (pinPage(tableMgmt->bufferManagerPtr, pageHandle, id.page) != RC_OK) {
+        return RC_ERROR;
+    }
+
+    char *pageData = pageHandle->data;
+    if (((PageHeader *)pageData)->pageIdentifier != 'Y' || pageData[sizeof(PageHeader) + id.slot] == 0) {
+        unpinPage(tableMgmt->bufferManagerPtr, pageHandle);
+        return RC_RECORD_NOT_FOUND;
+    }
+    for (int i = 0; i < tableMgmt->paxColumnCount; i++) {
+        PaxColumn *column = &tableMgmt->paxColumns[i];
+        memcpy(pageData + column->pageOffset + id.slot * column->size, record->data + column->recordOffset, column->size);
+    }
+
+    RC dirtyStatus = markDirty(tableMgmt->bufferManagerPtr, pageHandle);
+    RC unpinStatus = unpinPage(tableMgmt->bufferManagerPtr, pageHandle);
+    if (dirtyStatus != RC_OK || unpinStatus != RC_OK) {
+        return RC_ERROR;
+    }
+    return RC_OK;
+}
+
+RC paxDeleteRecord(TableManager *tableMgmt, RID id) {
+    BM_PageHandle *pageHandle = tableMgmt->pageHandlePtr;
+    RC pinStatus = pinPage(tableMgmt->bufferManagerPtr, pageHandle, id.page);
+    if (pinStatus != RC_OK) {
+        return pinStatus;
+    }
+
+    char *pageData = pageHandle->data;
+    PageHeader *header = (PageHeader *)pageData;
+    if (header->pageIdentifier != 'Y' || pageData[sizeof(PageHeader) + id.slot] == 0) {
+        unpinPage(tableMgmt->bufferManagerPtr, pageHandle);
+        return RC_RECORD_NOT_FOUND;
+    }
+    pageData[sizeof(PageHeader) + id.slot] = 0;
+    if (id.slot < header->nextFreeSlotInd) {
+        header->nextFreeSlotInd = id.slot;
+    }
+    header->totalTuples = header->totalTuples > 0 ? header->totalTuples - 1 : 0;
+    if (header->freeSlotCnt++ == 0) {
+        header->nextFreePageIndex = tableMgmt->firstFreePageNum;
+        header->onFreeList = TRUE;
+        tableMgmt->firstFreePageNum = id.page;
+    }
+    tableMgmt->totalTuples = tableMgmt->totalTuples > 0 ? tableMgmt->totalTuples - 1 : 0;
+
+    RC dirtyStatus = markDirty(tableMgmt->bufferManagerPtr, pageHandle);
+    RC unpinStatus = unpinPage(tableMgmt->bufferManagerPtr, pageHandle);
+    if (dirtyStatus != RC_OK || unpinStatus != RC_OK) {
+        return RC_ERROR;
+    }
+    return RC_OK;
+}
+
+
+// Helper function, a condition on one attribute of a PAX table is checked on
+// its minipage alone; -1 when scans have to read whole records
+int scanFilterAttr(TableManager *tableManager, Expr *cond) {
+    if (tableManager->layout != RM_LAYOUT_PAX || cond == NULL) {
+        return -1;
+    }
+    int attr = conditionAttr(cond);
+    return attr >= 0 ? attr : -1;
+}
+
+// Helper function, flags every attribute cond reads in attrMask
+void markConditionAttrs(Expr *cond, bool *attrMask) {
+    if (cond->type == EXPR_ATTRREF) {
+        attrMask[cond->expr.attrRef] = TRUE;
+    } else if (cond->type == EXPR_OP) {
+        Operator *op = cond->expr.op;
+        markConditionAttrs(op->args[0], attrMask);
+        if (op->type != OP_BOOL_NOT) {
+            markConditionAttrs(op->args[1], attrMask);
+        }
+    }
+}
+
+// Helper function, the one attribute a condition reads, COND_NO_ATTR when it
+// reads none and COND_MANY_ATTRS when it reads several
+int conditionAttr(Expr *expr) {
+    switch (expr->type) {
+        case EXPR_ATTRREF:
+            return expr->expr.attrRef;
+        case EXPR_CONST:
+            return COND_NO_ATTR;
+        default: {
+            Operator *op = expr->expr.op;
+            int left = conditionAttr(op->args[0]);
+            if (op->type == OP_BOOL_NOT || left == COND_MANY_ATTRS) {
+                return left;
+            }
+            int right = conditionAttr(op->args[1]);
+            if (left == COND_NO_ATTR || left == right) {
+                return right;
+            }
+            return right == COND_NO_ATTR ? left : COND_MANY_ATTRS;
+        }
+    }
+}
 
 Schema *createSchema(int numAttr, char **attrNames, DataType *dataTypes, int *typeLength, int keySize, int *keys) {
     Schema *newSchema = (Schema *)malloc(sizeof(Schema));
@@ -585,6 +1440,34 @@ RC freeSchema(Schema *schema) {
 }
 
 
+Schema *createProjectionSchema(Schema *schema, int numAttrs, int *attrs) {
+    if (numAttrs <= 0 || numAttrs > schema->numAttr) {
+        return NULL;
+    }
+    char **attrNames = malloc(numAttrs * sizeof(char *));
+    DataType *dataTypes = malloc(numAttrs * sizeof(DataType));
+    int *typeLength = malloc(numAttrs * sizeof(int));
+    Schema *projection = NULL;
+    if (attrNames && dataTypes && typeLength) {
+        int i;
+        for (i = 0; i < numAttrs; i++) {
+            if (attrs[i] < 0 || attrs[i] >= schema->numAttr) {
+                break;
+            }
+            attrNames[i] = schema->attrNames[attrs[i]];
+            dataTypes[i] = schema->dataTypes[attrs[i]];
+            typeLength[i] = schema->typeLength[attrs[i]];
+        }
+        if (i == numAttrs) {
+            projection = createSchema(numAttrs, attrNames, dataTypes, typeLength, 0, attrs);
+        }
+    }
+    free(attrNames);
+    free(dataTypes);
+    free(typeLength);
+    return projection;
+}
+
 int getRecordSize(Schema *schema) {
     int totalSize = 0;
     int i;
@@ -648,81 +1531,557 @@ RC freeRecord(Record *record) {
 
 RC startScan(RM_TableData *rel, RM_ScanHandle *scan, Expr *conditionExpression) {
     ScanManager *scanManager = (ScanManager *)calloc(1, sizeof(ScanManager));
-    if (!scanManager) return RC_MEMORY_ALLOCATION_FAIL;
+    BM_PageHandle *scanPage = (BM_PageHandle *)calloc(1, sizeof(BM_PageHandle));
+    if (!scanManager || !scanPage) {
+        free(scanManager);
+        free(scanPage);
+        return RC_MEMORY_ALLOCATION_FAIL;
+    }
+    scanPage->pageNum = NO_PAGE;
 
     TableManager *tableManager = (TableManager *)rel->mgmtData;
     *scanManager = (ScanManager){
         .totalEntries = tableManager->totalTuples,
-        .currentPageNum = tableManager->firstDataPageNum,
+        // data pages start behind the table header on page 0
+        .currentPageNum = 0,
         .currentSlotNum = -1,
         .scanIndex = 0,
-        .conditionExpression = conditionExpression
+        .conditionExpression = conditionExpression,
+        .scanPageHandlePtr = scanPage
     };
+    scanManager->filterAttr = scanFilterAttr(tableManager, conditionExpression);
     scan->mgmtData = scanManager;
     scan->rel = rel;
 
     return RC_OK;
 }
 
+RC startProjectedScan(RM_TableData *rel, RM_ScanHandle *scan, Expr *cond, int numAttrs, int *attrs) {
+    Schema *projection = createProjectionSchema(rel->schema, numAttrs, attrs);
+    if (projection == NULL) {
+        return RC_ERROR;
+    }
+    RC scanStatus = startScan(rel, scan, cond);
+    if (scanStatus != RC_OK) {
+        freeSchema(projection);
+        return scanStatus;
+    }
+
+    ScanManager *scanMgr = scan->mgmtData;
+    TableManager *tableMgr = rel->mgmtData;
+    scanMgr->projection = calloc(numAttrs, sizeof(ProjectedAttr));
+    scanMgr->attrMask = calloc(rel->schema->numAttr, sizeof(bool));
+    scanMgr->rowData = calloc(1, tableMgr->recSize);
+    if (!scanMgr->projection || !scanMgr->attrMask || !scanMgr->rowData) {
+        freeSchema(projection);
+        closeScan(scan);
+        return RC_MEMORY_ALLOCATION_FAIL;
+    }
+    // records are read into rowData, decoding only what the projection and
+    // the condition need, and the projected attributes copied out of it
+    scanMgr->numProjected = numAttrs;
+    for (int i = 0; i < numAttrs; i++) {
+        ProjectedAttr *attr = &scanMgr->projection[i];
+        attr->recordOffset = getAttrPos(rel->schema, attrs[i]);
+        attr->outputOffset = getAttrPos(projection, i);
+        attr->size = attrStoredSize(rel->schema, attrs[i]);
+        scanMgr->attrMask[attrs[i]] = TRUE;
+    }
+    if (cond != NULL) {
+        markConditionAttrs(cond, scanMgr->attrMask);
+    }
+    freeSchema(projection);
+    return RC_OK;
+}
+
 RC next(RM_ScanHandle *scan, Record *record) {
     ScanManager *scanMgr = scan->mgmtData;
-    RM_TableData *tableData = scan->rel;
-    TableManager *tableMgr = tableData->mgmtData;
+    bool matches;
+
+    for (;;) {
+        RC scanStatus = scanNextRecord(scan, record, scanMgr->conditionExpression, &matches);
+        if (scanStatus != RC_OK || matches) {
+            return scanStatus;
+        }
+    }
+}
 
-    int pageHeaderSize = sizeof(PageHeader);
-    int extraBytesPerRecord = sizeof(char) * 2;  
-    int sizePerRecord = tableMgr->recSize + extraBytesPerRecord;
-    int totalUsableSpace = PAGE_SIZE - pageHeaderSize;
-    int slotsPerPage = totalUsableSpace / sizePerRecord;
+RC nextBatch(RM_ScanHandle *scan, RecordBatch *batch, int maxRows) {
+    ScanManager *scanMgr = scan->mgmtData;
+    Record row;
+    bool matches;
 
-    bool hasScannedAllTuples = scanMgr->scanIndex >= scanMgr->totalEntries;
-    if (hasScannedAllTuples) {
+    if (maxRows > batch->capacity) {
+        maxRows = batch->capacity;
+    }
+    batch->numRows = 0;
+    batch->numSelected = 0;
+
+    // fill the batch first, the condition is evaluated over all rows at once
+    // below; rows of a projected scan lack the attributes it reads, so those
+    // are filtered while reading
+    Expr *readCond = scanMgr->projection != NULL ? scanMgr->conditionExpression : NULL;
+    while (batch->numRows < maxRows) {
+        row.data = batch->data + batch->numRows * batch->recSize;
+        RC scanStatus = scanNextRecord(scan, &row, readCond, &matches);
+        if (scanStatus == RC_RM_NO_MORE_TUPLES) {
+            break;
+        }
+        if (scanStatus != RC_OK) {
+            return scanStatus;
+        }
+        if (matches) {
+            batch->ids[batch->numRows++] = row.id;
+        }
+    }
+    if (batch->numRows == 0) {
         return RC_RM_NO_MORE_TUPLES;
     }
 
-    Value *evalResult = (Value *)calloc(1, sizeof(Value));
-    for (;;) { 
-        scanMgr->currentSlotNum++;
-        if (scanMgr->currentSlotNum >= slotsPerPage) {
+    for (int i = 0; i < batch->numRows; i++) {
+        batch->selection[i] = i;
+    }
+    batch->numSelected = batch->numRows;
+    if (readCond == NULL && scanMgr->conditionExpression != NULL) {
+        batch->numSelected = evalBatch(scan->rel, batch, scanMgr->conditionExpression,
+                                       batch->selection, batch->numRows, batch->selection);
+    }
+    return RC_OK;
+}
+
+RC createRecordBatch(RecordBatch **batch, Schema *schema, int capacity) {
+    RecordBatch *newBatch = calloc(1, sizeof(RecordBatch));
+    if (newBatch == NULL) {
+        return RC_MEMORY_ALLOCATION_FAIL;
+    }
+    newBatch->capacity = capacity;
+    newBatch->recSize = getRecordSize(schema);
+    newBatch->data = calloc(capacity, newBatch->recSize);
+    newBatch->ids = calloc(capacity, sizeof(RID));
+    newBatch->selection = calloc(capacity, sizeof(int));
+    if (!newBatch->data || !newBatch->ids || !newBatch->selection) {
+        freeRecordBatch(newBatch);
+        return RC_MEMORY_ALLOCATION_FAIL;
+    }
+    *batch = newBatch;
+    return RC_OK;
+}
+
+RC freeRecordBatch(RecordBatch *batch) {
+    if (!batch) return RC_RECORD_NOT_FOUND;
+
+    free(batch->data);
+    free(batch->ids);
+    free(batch->selection);
+    free(batch);
+    return RC_OK;
+}
+
+// Helper function, moves the scan to the next slot holding a record, reads
+// it and checks cond on it; matches is TRUE when cond is NULL
+RC scanNextRecord(RM_ScanHandle *scan, Record *record, Expr *cond, bool *matches) {
+    ScanManager *scanMgr = scan->mgmtData;
+    RM_TableData *tableData = scan->rel;
+    TableManager *tableMgr = tableData->mgmtData;
+    BM_PageHandle *scanPage = scanMgr->scanPageHandlePtr;
+
+    // the current page stays pinned across calls and its slots are read in place
+    while (scanMgr->scanIndex < scanMgr->totalEntries) {
+        if (scanPage->pageNum == NO_PAGE || scanMgr->currentSlotNum + 1 >= slotsOnPage(tableMgr, scanPage->data)) {
+            releaseScanPage(tableMgr, scanPage);
+            if (scanMgr->currentPageNum >= tableMgr->lastDataPageNum) {
+                break;
+            }
             scanMgr->currentPageNum++;
-            scanMgr->currentSlotNum = 0;
-   
-        }
-
-        RID currentRID = {.page = scanMgr->currentPageNum, .slot = scanMgr->currentSlotNum};
-        RC recordStatus = getRecord(tableData, currentRID, record);
-        if (recordStatus == RC_OK) {
-            scanMgr->scanIndex++;
-            if (scanMgr->conditionExpression) { 
-                evalExpr(record, tableData->schema, scanMgr->conditionExpression, &evalResult);
-                if (evalResult->v.boolV) {
-                    free(evalResult);
-                    return RC_OK;
-                }
-            } else { 
-                free(evalResult);
-                return RC_OK;
+            scanMgr->currentSlotNum = -1;
+            if (pinPage(tableMgr->bufferManagerPtr, scanPage, scanMgr->currentPageNum) != RC_OK) {
+                scanPage->pageNum = NO_PAGE;
+                return RC_ERROR;
             }
+            continue;
         }
 
-        if (scanMgr->scanIndex >= scanMgr->totalEntries) {
-            free(evalResult);
-            return RC_RM_NO_MORE_TUPLES;
+        scanMgr->currentSlotNum++;
+        Record row = { .data = scanMgr->rowData };
+        Record *target = scanMgr->projection != NULL ? &row : record;
+        RC slotStatus = scanSlot(tableData, scanMgr, scanPage->data, scanMgr->currentSlotNum, target, cond, matches);
+        if (slotStatus == RC_RECORD_NOT_FOUND) {
+            continue;
         }
+        if (slotStatus != RC_OK) {
+            return slotStatus;
+        }
+        if (target != record && *matches) {
+            projectRecord(scanMgr, row.data, record->data);
+        }
+        scanMgr->scanIndex++;
+        record->id.page = scanMgr->currentPageNum;
+        record->id.slot = scanMgr->currentSlotNum;
+        return RC_OK;
     }
-    free(evalResult);
-    return RC_GENERAL_ERROR; 
+
+    releaseScanPage(tableMgr, scanPage);
+    return RC_RM_NO_MORE_TUPLES;
 }
 
 RC closeScan(RM_ScanHandle *scan) {
     if (!scan) return RC_RECORD_NOT_FOUND;
 
+    ScanManager *scanMgr = scan->mgmtData;
+    if (scanMgr != NULL) {
+        releaseScanPage(scan->rel->mgmtData, scanMgr->scanPageHandlePtr);
+        free(scanMgr->scanPageHandlePtr);
+        free(scanMgr->projection);
+        free(scanMgr->attrMask);
+        free(scanMgr->rowData);
+    }
     free(scan->mgmtData);
     scan->mgmtData = NULL;
 
     return RC_OK;
 }
 
+RC startParallelScan(RM_TableData *rel, Expr *cond, int nThreads, RM_ScanCallback callback, void *arg) {
+    TableManager *tableMgr = rel->mgmtData;
+    int numMorsels = (tableMgr->lastDataPageNum + SCAN_MORSEL_PAGES - 1) / SCAN_MORSEL_PAGES;
+    BM_PoolStats poolStats;
+
+    if (callback == NULL) {
+        return RC_ERROR;
+    }
+    // a worker holds one page at a time; reading a forwarded row briefly pins
+    // the page it moved to as well, which the frame kept back here covers.
+    // Read-ahead may take up to its window of frames once the scan runs, and
+    // workers wait for a frame rather than fail, so the frames left over must
+    // be enough for every worker to finish its page
+    if (getPoolStats(tableMgr->bufferManagerPtr, &poolStats) != RC_OK) {
+        return RC_ERROR;
+    }
+    int maxWorkers = poolStats.totalFrames - poolStats.pinnedFrames - poolStats.readAheadDepth;
+    if (tableMgr->layout == RM_LAYOUT_ROW) {
+        maxWorkers--;
+    }
+    if (nThreads > maxWorkers) {
+        nThreads = maxWorkers;
+    }
+    if (nThreads > numMorsels) {
+        nThreads = numMorsels;
+    }
+    if (nThreads < 1) {
+        nThreads = 1;
+    }
+    if (numMorsels == 0) {
+        return RC_OK;
+    }
+
+    ParallelScan scan = {
+        .rel = rel,
+        .cond = cond,
+        .filterAttr = scanFilterAttr(tableMgr, cond),
+        .callback = callback,
+        .arg = arg,
+        .numWorkers = nThreads,
+        .status = RC_OK
+    };
+    scan.queues = calloc(nThreads, sizeof(MorselQueue));
+    ScanWorker *workers = calloc(nThreads, sizeof(ScanWorker));
+    if (!scan.queues || !workers) {
+        free(scan.queues);
+        free(workers);
+        return RC_MEMORY_ALLOCATION_FAIL;
+    }
+    pthread_mutex_init(&scan.statusLock, NULL);
+    // each worker starts on its own run of neighbouring morsels
+    for (int i = 0; i < nThreads; i++) {
+        pthread_mutex_init(&scan.queues[i].lock, NULL);
+        scan.queues[i].next = (int)((long)numMorsels * i / nThreads);
+        scan.queues[i].end = (int)((long)numMorsels * (i + 1) / nThreads);
+        workers[i].scan = &scan;
+        workers[i].id = i;
+    }
+
+    // the calling thread is worker 0; morsels of a worker that failed to
+    // start are stolen by the others
+    for (int i = 1; i < nThreads; i++) {
+        workers[i].started = pthread_create(&workers[i].thread, NULL, parallelScanWorker, &workers[i]) == 0;
+    }
+    parallelScanWorker(&workers[0]);
+    for (int i = 1; i < nThreads; i++) {
+        if (workers[i].started) {
+            pthread_join(workers[i].thread, NULL);
+        }
+    }
+
+    for (int i = 0; i < nThreads; i++) {
+        pthread_mutex_destroy(&scan.queues[i].lock);
+    }
+    pthread_mutex_destroy(&scan.statusLock);
+    free(scan.queues);
+    free(workers);
+    return scan.status;
+}
+
+// Helper function, runs a parallel scan worker until no morsel is left
+void *parallelScanWorker(void *arg) {
+    ScanWorker *worker = arg;
+    ParallelScan *scan = worker->scan;
+    ScanManager slotFilter = { .filterAttr = scan->filterAttr, .waitForFrame = TRUE };
+    Record *record;
+    int morsel;
+
+    if (createRecord(&record, scan->rel->schema) != RC_OK) {
+        stopParallelScan(scan, RC_MEMORY_ALLOCATION_FAIL);
+        return NULL;
+    }
+    while (parallelScanRunning(scan) && (morsel = takeMorsel(scan, worker->id)) >= 0) {
+        RC morselStatus = scanMorsel(scan, &slotFilter, morsel, record);
+        if (morselStatus != RC_OK) {
+            stopParallelScan(scan, morselStatus);
+        }
+    }
+    freeRecord(record);
+    return NULL;
+}
+
+// Helper function, the next morsel from the worker's own queue, else one
+// stolen from the back of another worker's; -1 once every queue is empty
+int takeMorsel(ParallelScan *scan, int workerId) {
+    for (int i = 0; i < scan->numWorkers; i++) {
+        MorselQueue *queue = &scan->queues[(workerId + i) % scan->numWorkers];
+        int morsel = -1;
+
+        pthread_mutex_lock(&queue->lock);
+        if (queue->next < queue->end) {
+            morsel = i == 0 ? queue->next++ : --queue->end;
+        }
+        pthread_mutex_unlock(&queue->lock);
+        if (morsel >= 0) {
+            return morsel;
+        }
+    }
+    return -1;
+}
+
+// Helper function, hands every record on the morsel's pages that satisfies
+// the scan condition to the callback
+RC scanMorsel(ParallelScan *scan, ScanManager *slotFilter, int morsel, Record *record) {
+    TableManager *tableMgr = scan->rel->mgmtData;
+    // data pages start behind the table header on page 0
+    int firstPage = 1 + morsel * SCAN_MORSEL_PAGES;
+    int lastPage = firstPage + SCAN_MORSEL_PAGES - 1;
+    BM_PageHandle page;
+    bool matches;
+
+    if (lastPage > tableMgr->lastDataPageNum) {
+        lastPage = tableMgr->lastDataPageNum;
+    }
+    for (int pageNum = firstPage; pageNum <= lastPage && parallelScanRunning(scan); pageNum++) {
+        RC status = pinPageWait(tableMgr->bufferManagerPtr, &page, pageNum);
+        if (status != RC_OK) {
+            return status;
+        }
+        int numSlots = slotsOnPage(tableMgr, page.data);
+        for (int slot = 0; slot < numSlots && status == RC_OK; slot++) {
+            status = scanSlot(scan->rel, slotFilter, page.data, slot, record, scan->cond, &matches);
+            if (status == RC_RECORD_NOT_FOUND) {
+                status = RC_OK;
+            } else if (status == RC_OK && matches) {
+                record->id.page = pageNum;
+                record->id.slot = slot;
+                status = scan->callback(scan->rel, record, scan->arg);
+            }
+        }
+        unpinPage(tableMgr->bufferManagerPtr, &page);
+        if (status != RC_OK) {
+            return status;
+        }
+    }
+    return RC_OK;
+}
+
+// Helper function
+bool parallelScanRunning(ParallelScan *scan) {
+    pthread_mutex_lock(&scan->statusLock);
+    bool running = scan->status == RC_OK;
+    pthread_mutex_unlock(&scan->statusLock);
+    return running;
+}
+
+// Helper function, records the first failure of a parallel scan
+void stopParallelScan(ParallelScan *scan, RC status) {
+    pthread_mutex_lock(&scan->statusLock);
+    if (scan->status == RC_OK) {
+        scan->status = status;
+    }
+    pthread_mutex_unlock(&scan->statusLock);
+}
+
+// Helper function, slots a scan visits on a pinned page; 0 for pages never formatted
+int slotsOnPage(TableManager *tableMgr, char *pageData) {
+    PageHeader *header = (PageHeader *)pageData;
+    if (header->pageIdentifier != 'Y') {
+        return 0;
+    }
+    return tableMgr->layout == RM_LAYOUT_PAX ? tableMgr->maxSlotsPerPage : header->numSlots;
+}
+
+// Helper function
+void releaseScanPage(TableManager *tableMgr, BM_PageHandle *scanPage) {
+    if (scanPage->pageNum != NO_PAGE) {
+        unpinPage(tableMgr->bufferManagerPtr, scanPage);
+        scanPage->pageNum = NO_PAGE;
+    }
+}
+
+// Helper function, reads one slot of the scan's pinned page into record and
+// checks the scan condition; RC_RECORD_NOT_FOUND for slots without a record
+RC scanSlot(RM_TableData *rel, ScanManager *scanMgr, char *pageData, int slot, Record *record, Expr *cond, bool *matches) {
+    TableManager *tableMgr = rel->mgmtData;
+
+    if (tableMgr->layout == RM_LAYOUT_PAX) {
+        if (pageData[sizeof(PageHeader) + slot] == 0) {
+            return RC_RECORD_NOT_FOUND;
+        }
+        if (cond != NULL && scanMgr->filterAttr >= 0) {
+            // the condition only needs the filter attribute's minipage
+            paxGather(tableMgr, pageData, slot, record->data, scanMgr->filterAttr, TRUE);
+            *matches = conditionHolds(record, rel->schema, cond);
+            if (*matches) {
+                paxGatherMasked(tableMgr, pageData, slot, record->data, scanMgr->attrMask, scanMgr->filterAttr);
+            }
+            return RC_OK;
+        }
+        paxGatherMasked(tableMgr, pageData, slot, record->data, scanMgr->attrMask, -1);
+    } else {
+        RC readStatus = readRowSlot(rel, pageData, slot, record->data, scanMgr->attrMask, scanMgr->waitForFrame);
+        if (readStatus != RC_OK) {
+            return readStatus;
+        }
+    }
+    *matches = cond == NULL || conditionHolds(record, rel->schema, cond);
+    return RC_OK;
+}
+
+// Helper function, narrows the batch rows listed in rows down to those that
+// satisfy expr, writing them to selected in the same order; selected may
+// alias rows. Comparisons of an int or float attribute with a constant run as
+// tight loops over the batch, anything else goes through evalExpr per row
+int evalBatch(RM_TableData *rel, RecordBatch *batch, Expr *expr, int *rows, int numRows, int *selected) {
+    if (expr->type == EXPR_OP) {
+        Operator *op = expr->expr.op;
+        switch (op->type) {
+            case OP_BOOL_AND: {
+                int numLeft = evalBatch(rel, batch, op->args[0], rows, numRows, selected);
+                return evalBatch(rel, batch, op->args[1], selected, numLeft, selected);
+            }
+            case OP_BOOL_OR:
+            case OP_BOOL_NOT: {
+                int *left = malloc(2 * numRows * sizeof(int));
+                if (left == NULL) {
+                    break;
+                }
+                int *right = left + numRows;
+                int numLeft = evalBatch(rel, batch, op->args[0], rows, numRows, left);
+                int numRight = 0;
+                if (op->type == OP_BOOL_OR) {
+                    numRight = evalBatch(rel, batch, op->args[1], rows, numRows, right);
+                }
+                // both sides are ordered subsets of rows, so one merge pass does it
+                int count = 0;
+                for (int i = 0, l = 0, r = 0; i < numRows; i++) {
+                    bool inLeft = l < numLeft && left[l] == rows[i];
+                    bool inRight = r < numRight && right[r] == rows[i];
+                    l += inLeft;
+                    r += inRight;
+                    if (op->type == OP_BOOL_OR ? (inLeft || inRight) : !inLeft) {
+                        selected[count++] = rows[i];
+                    }
+                }
+                free(left);
+                return count;
+            }
+            default: {
+                int count = compareBatch(rel, batch, op, rows, numRows, selected);
+                if (count >= 0) {
+                    return count;
+                }
+            }
+        }
+    }
+
+    Record row;
+    int count = 0;
+    for (int i = 0; i < numRows; i++) {
+        row.id = batch->ids[rows[i]];
+        row.data = batch->data + rows[i] * batch->recSize;
+        if (conditionHolds(&row, rel->schema, expr)) {
+            selected[count++] = rows[i];
+        }
+    }
+    return count;
+}
+
+// Helper function, the tight loops of evalBatch; -1 when the comparison is
+// not between an int or float attribute and a constant of the same type
+int compareBatch(RM_TableData *rel, RecordBatch *batch, Operator *op, int *rows, int numRows, int *selected) {
+    Expr *left = op->args[0];
+    Expr *right = op->args[1];
+    bool constLeft = left->type == EXPR_CONST;
+    Expr *attrExpr = constLeft ? right : left;
+    Expr *constExpr = constLeft ? left : right;
+    if (attrExpr->type != EXPR_ATTRREF || constExpr->type != EXPR_CONST) {
+        return -1;
+    }
+    int attrNum = attrExpr->expr.attrRef;
+    Value *constant = constExpr->expr.cons;
+    DataType type = rel->schema->dataTypes[attrNum];
+    if (constant->dt != type || (type != DT_INT && type != DT_FLOAT)) {
+        return -1;
+    }
+
+    const char *column = batch->data + getAttrPos(rel->schema, attrNum);
+    int recSize = batch->recSize;
+    int count = 0;
+    for (int i = 0; i < numRows; i++) {
+        const char *value = column + rows[i] * recSize;
+        bool holds;
+        if (type == DT_INT) {
+            int v;
+            memcpy(&v, value, sizeof(int));
+            int c = constant->v.intV;
+            holds = op->type == OP_COMP_EQUAL ? v == c : (constLeft ? c < v : v < c);
+        } else {
+            float v;
+            memcpy(&v, value, sizeof(float));
+            float c = constant->v.floatV;
+            holds = op->type == OP_COMP_EQUAL ? v == c : (constLeft ? c < v : v < c);
+        }
+        selected[count] = rows[i];
+        count += holds;
+    }
+    return count;
+}
+
+// Helper function, copies the projected attributes of a record read into
+// rowData to their packed offsets in data
+void projectRecord(ScanManager *scanMgr, const char *rowData, char *data) {
+    for (int i = 0; i < scanMgr->numProjected; i++) {
+        ProjectedAttr *attr = &scanMgr->projection[i];
+        memcpy(data + attr->outputOffset, rowData + attr->recordOffset, attr->size);
+    }
+}
+
+// Helper function
+bool conditionHolds(Record *record, Schema *schema, Expr *cond) {
+    Value *result;
+    if (evalExpr(record, schema, cond, &result) != RC_OK) {
+        return FALSE;
+    }
+    bool holds = result->v.boolV;
+    freeVal(result);
+    return holds;
+}
+
 RC getAttr(Record *record, Schema *schema, int attrNum, Value **value) {
     *value = (Value *)calloc(1, sizeof(Value));
     (*value)->dt = schema->dataTypes[attrNum];
@@ -774,6 +2133,57 @@ RC setAttr(Record *record, Schema *schema, int attrNum, Value *value) {
     return RC_OK;
 }
 
+RC getRecordRefAttr(RecordRef *ref, int attrNum, Value **value) {
+    Schema *schema = ref->rel->schema;
+    TableManager *tableManager = ref->rel->mgmtData;
+    const char *attr;
+    int length;
+
+    if (attrNum < 0 || attrNum >= schema->numAttr) {
+        return RC_ERROR;
+    }
+    if (tableManager->layout == RM_LAYOUT_PAX) {
+        PaxColumn *column = &tableManager->paxColumns[attrNum];
+        attr = ref->page.data + column->pageOffset + ref->id.slot * column->size;
+        length = schema->dataTypes[attrNum] == DT_STRING ? strnlen(attr, column->size) : column->size;
+    } else {
+        // step over the encoded attributes in front of attrNum
+        attr = ref->body;
+        for (int i = 0; i <= attrNum; i++) {
+            if (schema->dataTypes[i] == DT_STRING) {
+                uint16_t stringLength;
+                memcpy(&stringLength, attr, sizeof(stringLength));
+                attr += sizeof(stringLength);
+                length = stringLength;
+            } else {
+                length = attrStoredSize(schema, i);
+            }
+            if (i < attrNum) {
+                attr += length;
+            }
+        }
+    }
+
+    *value = (Value *)calloc(1, sizeof(Value));
+    (*value)->dt = schema->dataTypes[attrNum];
+    switch (schema->dataTypes[attrNum]) {
+        case DT_STRING:
+            (*value)->v.stringV = (char *)calloc(1, schema->typeLength[attrNum] + 1);
+            memcpy((*value)->v.stringV, attr, length);
+            break;
+        case DT_INT:
+            memcpy(&(*value)->v.intV, attr, sizeof(int));
+            break;
+        case DT_FLOAT:
+            memcpy(&(*value)->v.floatV, attr, sizeof(float));
+            break;
+        case DT_BOOL:
+            memcpy(&(*value)->v.boolV, attr, sizeof(bool));
+            break;
+    }
+    return RC_OK;
+}
+
 int getAttrPos(Schema *schema, int attrNum) {
     int attrPos = 0;
     int sizes[] = {sizeof(int), sizeof(float), 0, sizeof(bool)}; 
@@ -1,6 +1,8 @@
 #ifndef RECORD_MGR_H
 #define RECORD_MGR_H
 
+#include <stdint.h>
+
 #include "dberror.h"
 #include "expr.h"
 #include "tables.h"
@@ -15,19 +17,70 @@ typedef struct RM_ScanHandle
 
 
 
+// how a table lays out its data pages
+typedef enum RM_PageLayout
+{
+     RM_LAYOUT_ROW = 0,   // slotted pages of whole records
+     RM_LAYOUT_PAX = 1    // one minipage per attribute, see PaxColumn
+}RM_PageLayout;
+
+// when a table's dirty pages reach the page file
+typedef enum RM_WriteBackMode
+{
+     RM_WRITE_BACK_ON_EVICT = 0,    // as their frames are reused or the table closes
+     RM_WRITE_BACK_BACKGROUND = 1   // a background writer keeps clean frames ready
+}RM_WriteBackMode;
+
+/*Structure of the buffer pool settings openTableWithOptions takes*/
+// poolSize is at least 2 and strategy RS_FIFO or RS_LRU; prefetchDepth is
+// the read-ahead window for sequential scans, 0 for none. A table on the
+// shared buffer pool only takes prefetchDepth from them
+typedef struct RM_TableOptions
+{
+     int poolSize;
+     ReplacementStrategy strategy;
+     int prefetchDepth;
+     RM_WriteBackMode writeBack;
+}RM_TableOptions;
+
+/*Structure describing one attribute's minipage on a PAX page*/
+// A PAX page keeps a presence byte per slot behind the page header, then the
+// values of each attribute in a contiguous array starting at pageOffset
+typedef struct PaxColumn
+{
+     int recordOffset;
+     int pageOffset;
+     int size;
+}PaxColumn;
+
 /*Structure to store the table manager information*/
 typedef struct TableManager
 {
      int totalTuples;
      int recSize;
+     // head of the list of data pages with a free slot, -1 when every page is full
      int firstFreePageNum;
      int firstFreeSlotNum;
      int firstDataPageNum;
+     // highest page holding records; a new page is appended behind it
+     int lastDataPageNum;
+     // largest on-page body of a record and the most slots a page can have
+     int maxRecordBytes;
+     int maxSlotsPerPage;
+     RM_PageLayout layout;
+     // per-attribute minipages of a PAX table, NULL for row tables
+     PaxColumn *paxColumns;
+     int paxColumnCount;
      BM_BufferPool *bufferManagerPtr;
      BM_PageHandle *pageHandlePtr;
 }TableManager;
 
 /*Structure of the Page Header*/
+// Data pages are slotted: a directory of SlotEntry grows from behind the
+// header, record bodies grow down from the end of the page and recordsStart
+// is the lowest of them. Free directory entries form a chain through
+// nextFreeSlotInd; nextFreePageIndex links the page into the table's free
+// page list while it has freeBytes for the largest record
 typedef struct PageHeader
 {
     char pageIdentifier;
@@ -38,8 +91,29 @@ typedef struct PageHeader
     int nextFreePageIndex;
     int prevDataPageIndex;
     int nextDataPageIndex;
+    int numSlots;
+    int recordsStart;
+    int freeBytes;
+    bool onFreeList;
 }PageHeader;
 
+/*Structure of a slot directory entry*/
+// a free entry has length 0 and keeps the next free entry in offset
+typedef struct SlotEntry
+{
+    uint16_t offset;
+    uint16_t length;
+}SlotEntry;
+
+/*Structure of one attribute a projected scan returns*/
+// copied from recordOffset of the full record to outputOffset of the packed one
+typedef struct ProjectedAttr
+{
+     int recordOffset;
+     int outputOffset;
+     int size;
+}ProjectedAttr;
+
 /*Structure to store the table manager information*/
 typedef struct ScanManager
 {
@@ -49,37 +123,108 @@ typedef struct ScanManager
      int currentSlotNum;
      Expr *conditionExpression;
      BM_PageHandle *scanPageHandlePtr;
+     // on PAX tables, the only attribute the condition reads, else -1
+     int filterAttr;
+     // parallel scan workers pin with pinPageWait, next() fails on a full pool
+     bool waitForFrame;
+     // projected scans only: the attributes next() returns, the ones read
+     // from the page and the full record they are read into
+     ProjectedAttr *projection;
+     int numProjected;
+     bool *attrMask;
+     char *rowData;
 }ScanManager;
 
+/*Structure of a batch of records filled by nextBatch*/
+// rows are stored back to back in data, recSize bytes each; selection lists
+// the rows that satisfy the scan condition, in scan order
+typedef struct RecordBatch
+{
+     int capacity;
+     int recSize;
+     int numRows;
+     char *data;
+     RID *ids;
+     int *selection;
+     int numSelected;
+}RecordBatch;
+
+/*Structure of a record read in place by getRecordRef*/
+// page stays pinned until releaseRecordRef. Row tables point body at the
+// record's encoded bytes in the frame, PAX tables read the minipages of
+// id.slot; getRecordRefAttr decodes one attribute from either
+typedef struct RecordRef
+{
+     RM_TableData *rel;
+     RID id;
+     BM_PageHandle page;
+     char *body;
+     int length;
+}RecordRef;
+
+// called by startParallelScan for each matching record; record is only
+// valid during the call, any result but RC_OK stops the scan
+typedef RC (*RM_ScanCallback) (RM_TableData *rel, Record *record, void *arg);
+
 // table and manager
 extern RC initRecordManager (void *mgmtData);
 extern RC shutdownRecordManager ();
 extern RC createTable (char *name, Schema *schema);
+extern RC createTableWithLayout (char *name, Schema *schema, RM_PageLayout layout);
+// both fail with RC_TABLE_FORMAT_UNSUPPORTED on a file whose header carries
+// another format version than this build writes
 extern RC openTable (RM_TableData *rel, char *name);
+extern RC openTableWithOptions (RM_TableData *rel, char *name, RM_TableOptions *options);
 extern RC closeTable (RM_TableData *rel);
 extern RC deleteTable (char *name);
 extern int getNumTuples (RM_TableData *rel);
 
 // handling records in a table
 extern RC insertRecord (RM_TableData *rel, Record *record);
+// inserts numRecords records, filling each page it pins before moving on,
+// and stores the table counters in the table header once at the end
+extern RC insertRecords (RM_TableData *rel, Record **records, int numRecords);
 extern RC deleteRecord (RM_TableData *rel, RID id);
 extern RC updateRecord (RM_TableData *rel, Record *record);
 extern RC getRecord (RM_TableData *rel, RID id, Record *record);
+// pins the record's page without copying the record; the table must not
+// change until the ref is released
+extern RC getRecordRef (RM_TableData *rel, RID id, RecordRef *ref);
+extern RC releaseRecordRef (RecordRef *ref);
 
 // scans
 extern RC startScan (RM_TableData *rel, RM_ScanHandle *scan, Expr *cond);
 extern RC next (RM_ScanHandle *scan, Record *record);
 extern RC closeScan (RM_ScanHandle *scan);
+// a scan whose next() fills record->data with only the listed attributes,
+// packed in list order as laid out by createProjectionSchema; the condition
+// may read any attribute of the table
+extern RC startProjectedScan (RM_TableData *rel, RM_ScanHandle *scan, Expr *cond, int numAttrs, int *attrs);
+// reads up to maxRows records into batch and evaluates the scan condition
+// over all of them; RC_OK while rows were read, even if none was selected
+extern RC nextBatch (RM_ScanHandle *scan, RecordBatch *batch, int maxRows);
+extern RC createRecordBatch (RecordBatch **batch, Schema *schema, int capacity);
+extern RC freeRecordBatch (RecordBatch *batch);
+// scans the table on up to nThreads threads and calls callback concurrently
+// for every record satisfying cond; returns once the scan is done, with the
+// first non-RC_OK callback result if the callback stopped it. Each thread
+// holds one frame, so the scan runs on at most the frames unpinned when it
+// starts, less the read-ahead window and, on row tables, one frame for
+// reading forwarded records; a worker that finds every frame pinned waits
+extern RC startParallelScan (RM_TableData *rel, Expr *cond, int nThreads, RM_ScanCallback callback, void *arg);
 
 // dealing with schemas
 extern int getRecordSize (Schema *schema);
 extern Schema *createSchema (int numAttr, char **attrNames, DataType *dataTypes, int *typeLength, int keySize, int *keys);
 extern RC freeSchema (Schema *schema);
+// the schema of the listed attributes of schema, in list order, without keys
+extern Schema *createProjectionSchema (Schema *schema, int numAttrs, int *attrs);
 
 // dealing with records and attribute values
 extern RC createRecord (Record **record, Schema *schema);
 extern RC freeRecord (Record *record);
 extern RC getAttr (Record *record, Schema *schema, int attrNum, Value **value);
 extern RC setAttr (Record *record, Schema *schema, int attrNum, Value *value);
+extern RC getRecordRefAttr (RecordRef *ref, int attrNum, Value **value);
 
 #endif // RECORD_MGR_H
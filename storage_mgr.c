@@ -1,3 +1,5 @@
+// O_DIRECT is a GNU extension
+#define _GNU_SOURCE
 #include<stdio.h>
 #include<stdlib.h>
 #include<sys/stat.h>
@@ -5,113 +7,380 @@
 #include<unistd.h>
 #include<string.h>
 #include<math.h>
+#include<limits.h>
+#include<sys/uio.h>
+#include<fcntl.h>
+#include<stdint.h>
+#include<errno.h>
+#include<pthread.h>
+#include<sys/mman.h>
+#include<sys/syscall.h>
+#include<linux/io_uring.h>
+#if defined(__x86_64__)
+#include<nmmintrin.h>
+#endif
 
 #include "storage_mgr.h"
 
-FILE *pageFile;
+// pwritev accepts at most this many pages per call
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+// direct I/O needs buffers, offsets and lengths aligned to the device block
+#define DIRECT_IO_ALIGNMENT 4096
+
+// ensureCapacity grows files in extents that double the allocated size,
+// bounded below and above so small files stay small and huge ones do not
+// reserve gigabytes at once
+#define MIN_EXTENT_PAGES 16
+#define MAX_EXTENT_PAGES 65536
+// zero fill chunk for file systems without FALLOC_FL_ZERO_RANGE
+#define ZERO_FILL_PAGES 64
+
+// compressed page files keep every page LZ compressed in a slot of whole
+// SLOT_UNIT blocks behind the header page. The indirection map saying where
+// each page lives has a region of its own among the slots; the header page
+// records where, next to the usual page count. Every write brings the map on
+// disk up to date, so a file that was never closed still opens
+#define SLOT_UNIT 512
+// the most units one page needs, free space is handed out in pieces this big
+#define MAX_SLOT_UNITS (PAGE_SIZE / SLOT_UNIT)
+#define COMPRESSED_MAGIC "SMLZPAGE"
+#define COMPRESSED_HEADER_OFFSET 64
+// LZ parameters, the block format is the one LZ4 uses
+#define LZ_HASH_BITS 12
+#define LZ_MIN_MATCH 4
+#define LZ_LAST_LITERALS 5
+
+// where one page of a compressed file lives; length is PAGE_SIZE for a page
+// stored raw because it did not compress, and 0 for a page never written
+typedef struct SM_PageSlot {
+    uint32_t unit;
+    uint16_t length;
+    uint16_t units;
+} SM_PageSlot;
+
+// kept in the header page of a compressed file at COMPRESSED_HEADER_OFFSET;
+// the map region at mapUnit has room for mapCapacity entries
+typedef struct SM_CompressedHeader {
+    char magic[8];
+    uint32_t mapUnit;
+    uint32_t numSlots;
+    uint32_t mapCapacity;
+} SM_CompressedHeader;
+
+// a run of units, used to find the free space between slots on open
+typedef struct SM_UnitRange {
+    uint32_t unit;
+    uint32_t units;
+} SM_UnitRange;
+
+// per-handle state kept in mgmtInfo. All I/O is positional on fd, so several
+// threads may read different pages of one handle at the same time, also while
+// another one writes or grows it; calls that write or grow the file still
+// need to be serialized by the caller
+typedef struct SM_FileInfo {
+    int fd;
+    int direct;
+    // read-only mapping of the whole file for handles from openPageFileMapped
+    char *map;
+    size_t mapBytes;
+    // data pages the file has zeroed space for; grows ahead of totalNumPages
+    int allocatedPages;
+    // indirection map and free slots of a compressed file; mapLock keeps
+    // readers off the map while a write changes or reallocates it
+    int compressed;
+    pthread_mutex_t mapLock;
+    SM_PageSlot *slots;
+    int slotCapacity;
+    SM_PageSlot *freeSlots;
+    int numFreeSlots;
+    int freeSlotCapacity;
+    // slots released since the map was last written; the map on disk may
+    // still point at them, so they are not reused before it is rewritten
+    SM_PageSlot *pendingSlots;
+    int numPendingSlots;
+    int pendingSlotCapacity;
+    // where the map lives on disk and the page count the header page holds
+    uint32_t mapUnit;
+    uint32_t mapCapacity;
+    int storedPages;
+    // first unit past the last slot
+    uint32_t dataUnits;
+} SM_FileInfo;
+
+// a submitted read, owned by the engine until its callback ran
+typedef struct SM_AsyncRequest {
+    SM_FileInfo *info;
+    int pageNum;
+    SM_PageHandle memPage;
+    SM_ReadCallback cb;
+    void *arg;
+    RC rc;
+    struct iovec iov;
+    struct SM_AsyncRequest *next;
+} SM_AsyncRequest;
+
+// reader threads used when io_uring is not available
+#define ASYNC_WORKER_THREADS 4
+
+// state behind SM_AsyncIO; ringFd is -1 when the thread pool does the reads
+typedef struct SM_AsyncEngine {
+    int ringFd;
+    void *sqRing;
+    void *cqRing;
+    size_t sqRingBytes;
+    size_t cqRingBytes;
+    size_t sqesBytes;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    // queued reads for the threads and finished reads for pollAsyncIO
+    pthread_mutex_t lock;
+    pthread_cond_t workAvailable;
+    pthread_cond_t workDone;
+    SM_AsyncRequest *todoHead;
+    SM_AsyncRequest *todoTail;
+    SM_AsyncRequest *doneHead;
+    SM_AsyncRequest *doneTail;
+    pthread_t workers[ASYNC_WORKER_THREADS];
+    int numWorkers;
+    int stopping;
+} SM_AsyncEngine;
+
+// whether openPageFile opens files with O_DIRECT
+static int directIO = 0;
+// whether createPageFile creates compressed page files
+static int pageCompression = 0;
+
+// CRC32C (Castagnoli) lookup table for CPUs without SSE4.2
+#define CRC32C_POLY 0x82F63B78u
+static uint32_t crc32cTable[256];
+// CRC32C of an all-zero page; page checksums are taken relative to it so that
+// the zeroed pages ensureCapacity allocates verify without ever being written
+static uint32_t zeroPageCrc;
+static int crc32cHardware = 0;
+static pthread_once_t crc32cOnce = PTHREAD_ONCE_INIT;
+
+static RC openPageFileWithFlags(char *fileName, SM_FileHandle *fHandle, int direct);
+static RC readPageAt(SM_FileInfo *info, off_t offset, SM_PageHandle memPage);
+static RC writePageAt(SM_FileInfo *info, off_t offset, SM_PageHandle memPage);
+static RC zeroPages(SM_FileInfo *info, int firstPage, int numPages);
+static size_t preadFully(int fd, char *buffer, size_t length, off_t offset);
+static size_t pwriteFully(int fd, const char *buffer, size_t length, off_t offset);
+static void formatHeader(char *pageData, int totalNumPages, SM_FileInfo *info);
+static RC writeHeaderPage(SM_FileInfo *info, int totalNumPages);
+static RC loadSlotMap(SM_FileInfo *info, const char *pageData, int totalNumPages);
+static RC findFreeSlots(SM_FileInfo *info, int totalNumPages);
+static int compareUnitRanges(const void *left, const void *right);
+static RC syncSlotMap(SM_FileInfo *info, int totalNumPages, int firstPage, int numPages);
+static RC moveSlotMap(SM_FileInfo *info, int totalNumPages);
+static RC addFreeUnits(SM_PageSlot **list, int *count, int *capacity, uint32_t unit, uint32_t units);
+static RC growSlotMap(SM_FileInfo *info, int numPages);
+static void freeSlotMap(SM_FileInfo *info);
+static RC readCompressedPage(SM_FileInfo *info, int pageNum, SM_PageHandle memPage);
+static RC writeCompressedPage(SM_FileInfo *info, int pageNum, SM_PageHandle memPage);
+static int lzEmitSequence(unsigned char *dst, int dstCapacity, int *op,
+        const unsigned char *literals, int numLiterals, int offset, int matchLength);
+static int lzCompress(const unsigned char *src, int srcLength, unsigned char *dst, int dstCapacity);
+static int lzDecompress(const unsigned char *src, int srcLength, unsigned char *dst, int dstLength);
+static void initCrc32c(void);
+static uint32_t crc32c(const void *data, size_t length);
+static uint32_t pageChecksum(SM_PageHandle memPage);
+static void setupRing(SM_AsyncEngine *engine, int queueDepth);
+static void *asyncWorkerMain(void *arg);
+static void pushRequest(SM_AsyncRequest **head, SM_AsyncRequest **tail, SM_AsyncRequest *req, SM_AsyncEngine *engine);
+static void completeRequest(SM_AsyncIO *aio, SM_AsyncRequest *req);
 
  void initStorageManager (void) {
-	pageFile = NULL;
+	directIO = 0;
+	pageCompression = 0;
+}
+
+// Define switch O_DIRECT on or off for page files opened from now on
+void setDirectIO(int enabled) {
+    directIO = enabled;
+}
+
+// Define create compressed page files from now on, or plain ones again
+void setPageCompression(int enabled) {
+    pageCompression = enabled;
 }
 
 // Define create a Page file 
  RC createPageFile(char *fileName) {
-    FILE *file = fopen(fileName, "w+");
-    if (file == NULL) {
+    int fd = open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
         return RC_FILE_NOT_FOUND; 
     }
     SM_PageHandle emptyPage = calloc(PAGE_SIZE, 1);
     if (emptyPage == NULL) {
-        fclose(file);
+        close(fd);
         return RC_WRITE_FAILED;
     }
-    size_t writeSize = fwrite(emptyPage, sizeof(char), PAGE_SIZE, file);
+    SM_FileInfo info = { fd, 0 };
+    info.compressed = pageCompression;
+    formatHeader(emptyPage, 0, &info);
+    RC rc = writePageAt(&info, 0, emptyPage);
     free(emptyPage);
-    fclose(file);
-    if (writeSize < PAGE_SIZE) {
-        return RC_WRITE_FAILED;
-    }
-    return RC_OK;
+    close(fd);
+    return rc;
 }
 
 // Define Open a Page file
 RC openPageFile(char *fileName, SM_FileHandle *fHandle) {
-    FILE *fp;
-    int File_RC;
-    char *pageData;
-    int i;
+    return openPageFileWithFlags(fileName, fHandle, directIO);
+}
+
+// Define Open a Page file with O_DIRECT, bypassing the kernel page cache
+RC openPageFileDirect(char *fileName, SM_FileHandle *fHandle) {
+    return openPageFileWithFlags(fileName, fHandle, 1);
+}
 
-    pageData = (char *) calloc(PAGE_SIZE, sizeof(char));
-    if (pageData == NULL) {
+// Define Open a Page file read-only through a shared memory mapping
+RC openPageFileMapped(char *fileName, SM_FileHandle *fHandle) {
+    struct stat st;
+    int fd = open(fileName, O_RDONLY);
+    if (fd == -1) {
+        return RC_FILE_NOT_FOUND;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size < PAGE_SIZE) {
+        close(fd);
+        return RC_READ_FAILED;
+    }
+    char *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return RC_READ_FAILED;
+    }
+    // compressed pages cannot be handed out in place
+    if (memcmp(map + COMPRESSED_HEADER_OFFSET, COMPRESSED_MAGIC, sizeof(((SM_CompressedHeader *)0)->magic)) == 0) {
+        munmap(map, st.st_size);
+        close(fd);
+        return RC_READ_FAILED;
+    }
+    SM_FileInfo *info = (SM_FileInfo *) calloc(1, sizeof(SM_FileInfo));
+    if (info == NULL) {
+        munmap(map, st.st_size);
+        close(fd);
         return RC_MEMORY_ALLOCATION_FAIL;
     }
-    fp = fopen(fileName, "rb+");
-    if (fp == NULL) {
-        free(pageData);
+    info->fd = fd;
+    info->direct = 0;
+    info->map = map;
+    info->mapBytes = st.st_size;
+    fHandle->fileName = fileName;
+    // never hand out pages the mapping does not cover
+    fHandle->totalNumPages = atoi(map);
+    if ((size_t)(fHandle->totalNumPages + 1) * PAGE_SIZE > info->mapBytes) {
+        fHandle->totalNumPages = info->mapBytes / PAGE_SIZE - 1;
+    }
+    fHandle->curPagePos = 0;
+    fHandle->mgmtInfo = info;
+    return RC_OK;
+}
+
+// Helper function
+static RC openPageFileWithFlags(char *fileName, SM_FileHandle *fHandle, int direct) {
+    char pageData[PAGE_SIZE] __attribute__((aligned(DIRECT_IO_ALIGNMENT)));
+    int fd = open(fileName, O_RDWR | (direct ? O_DIRECT : 0));
+    if (fd == -1 && direct && errno == EINVAL) {
+        // the file system does not do direct I/O, go through the page cache
+        fd = open(fileName, O_RDWR);
+        direct = 0;
+    }
+    if (fd == -1) {
         return RC_FILE_NOT_FOUND;
     }
-    int DataReadOK = 0;
-    for (i = 0; i < 1; i++) {
-        File_RC = fread(pageData, PAGE_SIZE, 1, fp);
-        if (File_RC == 1) {
-            DataReadOK = 1;
-            break;
-        }
+    SM_FileInfo *info = (SM_FileInfo *) calloc(1, sizeof(SM_FileInfo));
+    if (info == NULL) {
+        close(fd);
+        return RC_MEMORY_ALLOCATION_FAIL;
     }
-    if (!DataReadOK) {
-        free(pageData);
-        fclose(fp); 
+    info->fd = fd;
+    info->direct = direct;
+    if (readPageAt(info, 0, pageData) != RC_OK) {
+        free(info);
+        close(fd);
         return RC_READ_FAILED;
     }
-    if (pageData != NULL) {
-        fHandle->fileName = fileName;
-        fHandle->totalNumPages = atoi(pageData);
-        fHandle->curPagePos = 0;
-        fHandle->mgmtInfo = fp;
-        free(pageData); 
-    } else {
-        fclose(fp);
-        free(pageData); 
-        return RC_INVALID_HEADER;
+    int totalNumPages = atoi(pageData);
+    if (memcmp(pageData + COMPRESSED_HEADER_OFFSET, COMPRESSED_MAGIC, sizeof(((SM_CompressedHeader *)0)->magic)) == 0) {
+        RC rc = RC_OK;
+        if (direct) {
+            // slots are not block aligned, so compressed files go through the page cache
+            int plainFd = open(fileName, O_RDWR);
+            if (plainFd == -1) {
+                rc = RC_FILE_NOT_FOUND;
+            } else {
+                close(fd);
+                info->fd = plainFd;
+                info->direct = 0;
+            }
+        }
+        if (rc == RC_OK) {
+            rc = loadSlotMap(info, pageData, totalNumPages);
+        }
+        if (rc != RC_OK) {
+            freeSlotMap(info);
+            close(info->fd);
+            free(info);
+            return rc;
+        }
     }
+    pthread_mutex_init(&info->mapLock, NULL);
+    fHandle->fileName = fileName;
+    fHandle->totalNumPages = totalNumPages;
+    fHandle->curPagePos = 0;
+    fHandle->mgmtInfo = info;
+    // whatever lies past the header's page count is zeroed again before use
+    info->allocatedPages = fHandle->totalNumPages;
     return RC_OK;
 }
 
 // Define Close a Page file 
 RC closePageFile(SM_FileHandle *fHandle) {
-    int FILE_RC;
-    char *pageData;
-    long offset;
-    int Action, maxTrial = 1;
+    SM_FileInfo *info = fHandle->mgmtInfo;
+    char pageData[PAGE_SIZE] __attribute__((aligned(DIRECT_IO_ALIGNMENT)));
 
-    pageData = (char *) calloc(PAGE_SIZE, sizeof(char));
-    if (pageData == NULL) {
-        return RC_MEMORY_ALLOCATION_FAIL;
+    if (info == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
     }
-    offset = 0;
-    FILE_RC = fseek(fHandle->mgmtInfo, offset, SEEK_SET);
-    if (FILE_RC != 0) {
-        free(pageData);
-        return RC_SEEK_FAILED;
+    RC rc = RC_OK;
+    if (info->map != NULL) {
+        // nothing to write back for a read-only mapping
+        munmap(info->map, info->mapBytes);
+    } else if (info->compressed) {
+        // the map is current after every write, rewrite it whole once more
+        // in case a failed write left some entries behind
+        rc = syncSlotMap(info, fHandle->totalNumPages, 0, fHandle->totalNumPages);
+        freeSlotMap(info);
+    } else {
+        formatHeader(pageData, fHandle->totalNumPages, info);
+        rc = writePageAt(info, 0, pageData);
+        // hand back the unused tail of the last extent
+        if (rc == RC_OK && info->allocatedPages > fHandle->totalNumPages) {
+            if (ftruncate(info->fd, (off_t)(fHandle->totalNumPages + 1) * PAGE_SIZE) != 0) {
+                rc = RC_WRITE_FAILED;
+            }
+        }
     }
-    sprintf(pageData, "%d", fHandle->totalNumPages);
-    for (Action = 0; Action < maxTrial; Action++) {
-        FILE_RC = fwrite(pageData, PAGE_SIZE, 1, fHandle->mgmtInfo);
-        if (FILE_RC != 1) {
-        free(pageData);
-        return RC_WRITE_FAILED;
-        } 
-        else {
-        // Close the file
-        FILE_RC = fclose(fHandle->mgmtInfo);
-        if (FILE_RC != 0) {
-            free(pageData);
-            return RC_CLOSE_FAILED;
-        }
-         }
-    free(pageData);
-    return RC_OK;
+    if (close(info->fd) != 0 && rc == RC_OK) {
+        rc = RC_CLOSE_FAILED;
     }
+    if (info->map == NULL) {
+        pthread_mutex_destroy(&info->mapLock);
+    }
+    free(info);
+    fHandle->mgmtInfo = NULL;
+    return rc;
 }
 
 // Define destroy a Page file 
@@ -135,28 +404,65 @@ RC destroyPageFile(char *fileName) {
 
 //  Define Read a block 
 RC readBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
-    long offset;
-    int FILE_RC;
-    int Action, maxTrial = 1; 
+    SM_FileInfo *info = fHandle->mgmtInfo;
+    if (info == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    // the page count may grow under a reader, the pages below it are ready
+    if (pageNum < 0 || pageNum >= __atomic_load_n(&fHandle->totalNumPages, __ATOMIC_ACQUIRE)) {
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+    RC rc = info->compressed ? readCompressedPage(info, pageNum, memPage)
+                             : readPageAt(info, (off_t)(pageNum + 1) * PAGE_SIZE, memPage);
+    if (rc == RC_OK) {
+        rc = verifyPageChecksum(memPage);
+    }
+    if (rc != RC_OK) {
+        return rc;
+    }
+    // concurrent readers of one handle race on the position, last one wins
+    __atomic_store_n(&fHandle->curPagePos, pageNum, __ATOMIC_RELAXED);
+    return RC_OK;
+}
+
+// Define a pointer to a page inside the mapping of a mapped handle
+RC mapBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle *memPage) {
+    SM_FileInfo *info = fHandle->mgmtInfo;
+    if (info == NULL || info->map == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
     if (pageNum < 0 || pageNum >= fHandle->totalNumPages) {
         return RC_READ_NON_EXISTING_PAGE;
     }
-    offset = (pageNum + 1) * PAGE_SIZE;
-    FILE_RC = fseek(fHandle->mgmtInfo, offset, SEEK_SET);
-    if (FILE_RC != 0) {
-        return RC_SEEK_FAILED;
+    *memPage = info->map + (size_t)(pageNum + 1) * PAGE_SIZE;
+    return RC_OK;
+}
+
+// Define pass an access pattern hint for a range of pages to the kernel
+RC adviseBlocks(int firstPage, int numPages, SM_FileHandle *fHandle, int advice) {
+    SM_FileInfo *info = fHandle->mgmtInfo;
+    if (info == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
     }
-    for (Action = 0; Action < maxTrial; Action++) {
-        FILE_RC = fread(memPage, PAGE_SIZE, 1, fHandle->mgmtInfo);
-        if (FILE_RC == 1) {
-            break;
+    if (firstPage < 0 || numPages <= 0 || info->compressed) {
+        return RC_OK;
+    }
+    if (firstPage + numPages > fHandle->totalNumPages) {
+        numPages = fHandle->totalNumPages - firstPage;
+        if (numPages <= 0) {
+            return RC_OK;
         }
     }
-    if (FILE_RC != 1) {
-        return RC_READ_FAILED;
+    off_t offset = (off_t)(firstPage + 1) * PAGE_SIZE;
+    size_t length = (size_t)numPages * PAGE_SIZE;
+    if (info->map != NULL) {
+        int madv = advice == SM_ADVICE_SEQUENTIAL ? MADV_SEQUENTIAL
+                 : advice == SM_ADVICE_RANDOM ? MADV_RANDOM : MADV_WILLNEED;
+        return madvise(info->map + offset, length, madv) == 0 ? RC_OK : RC_ERROR;
     }
-    fHandle->curPagePos = pageNum;
-    return RC_OK;
+    int fadv = advice == SM_ADVICE_SEQUENTIAL ? POSIX_FADV_SEQUENTIAL
+             : advice == SM_ADVICE_RANDOM ? POSIX_FADV_RANDOM : POSIX_FADV_WILLNEED;
+    return posix_fadvise(info->fd, offset, length, fadv) == 0 ? RC_OK : RC_ERROR;
 }
 
 // Define Read first block 
@@ -253,38 +559,125 @@ RC readNextBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
 
 // Define write block
 RC writeBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
-    FILE *fp = fHandle->mgmtInfo;
-    long int offset;
-    if (fp == NULL) {
+    SM_FileInfo *info = fHandle->mgmtInfo;
+    if (info == NULL) {
         return RC_FILE_NOT_FOUND; 
     }
-    if (pageNum < 0) {
+    // a write may grow the file by the next page only
+    if (pageNum < 0 || pageNum > fHandle->totalNumPages) {
         return RC_WRITE_FAILED; 
     }
-    offset = (pageNum + 1) * PAGE_SIZE;
-    fseek(fp, 0, SEEK_END);
-    long fileSize = ftell(fp);
-    if (offset > fileSize) {
-        if (pageNum == fHandle->totalNumPages) {
-            fseek(fp, fileSize, SEEK_SET);
-            for (long i = fileSize; i < offset; i++) {
-                fputc('\0', fp);
+    RC rc;
+    int totalNumPages = pageNum == fHandle->totalNumPages ? pageNum + 1 : fHandle->totalNumPages;
+    setPageChecksum(memPage);
+    if (info->compressed) {
+        pthread_mutex_lock(&info->mapLock);
+        rc = growSlotMap(info, pageNum + 1);
+        if (rc == RC_OK) {
+            rc = writeCompressedPage(info, pageNum, memPage);
+        }
+        if (rc == RC_OK) {
+            rc = syncSlotMap(info, totalNumPages, pageNum, 1);
+        }
+        pthread_mutex_unlock(&info->mapLock);
+    } else {
+        rc = writePageAt(info, (off_t)(pageNum + 1) * PAGE_SIZE, memPage);
+    }
+    if (rc != RC_OK) {
+        return rc;
+    }
+    if (info->allocatedPages < totalNumPages) {
+        info->allocatedPages = totalNumPages;
+    }
+    __atomic_store_n(&fHandle->totalNumPages, totalNumPages, __ATOMIC_RELEASE);
+    __atomic_store_n(&fHandle->curPagePos, pageNum, __ATOMIC_RELAXED);
+    return RC_OK;
+}
+
+// Define write a run of consecutive blocks with one vectored write per IOV_MAX pages
+RC writeBlocks(int pageNum, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages) {
+    SM_FileInfo *info = fHandle->mgmtInfo;
+    struct iovec iov[IOV_MAX];
+    if (info == NULL) {
+        return RC_FILE_NOT_FOUND;
+    }
+    if (info->map != NULL || pageNum < 0 || numPages < 0 || pageNum + numPages > fHandle->totalNumPages) {
+        return RC_WRITE_FAILED;
+    }
+    for (int k = 0; k < numPages; k++) {
+        setPageChecksum(memPages[k]);
+    }
+    if (info->compressed) {
+        // every page lands in its own slot, there is no run to vector
+        RC rc = RC_OK;
+        int written = 0;
+        pthread_mutex_lock(&info->mapLock);
+        while (rc == RC_OK && written < numPages) {
+            rc = writeCompressedPage(info, pageNum + written, memPages[written]);
+            if (rc == RC_OK) {
+                written++;
+            }
+        }
+        // record the pages that did make it even when a later one failed
+        RC syncRc = syncSlotMap(info, fHandle->totalNumPages, pageNum, written);
+        pthread_mutex_unlock(&info->mapLock);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        if (syncRc != RC_OK) {
+            return syncRc;
+        }
+        __atomic_store_n(&fHandle->curPagePos, pageNum + numPages - 1, __ATOMIC_RELAXED);
+        return RC_OK;
+    }
+    if (info->direct) {
+        for (int i = 0; i < numPages; i++) {
+            if ((uintptr_t)memPages[i] % DIRECT_IO_ALIGNMENT != 0) {
+                // an unaligned page cannot join a direct vectored write
+                for (int k = 0; k < numPages; k++) {
+                    RC rc = writePageAt(info, (off_t)(pageNum + k + 1) * PAGE_SIZE, memPages[k]);
+                    if (rc != RC_OK) {
+                        return rc;
+                    }
+                }
+                __atomic_store_n(&fHandle->curPagePos, pageNum + numPages - 1, __ATOMIC_RELAXED);
+                return RC_OK;
             }
-            fHandle->totalNumPages++; 
-        } else {
-            return RC_WRITE_FAILED; 
         }
     }
-        if (lseek(fileno(fp), offset, SEEK_SET) == -1) {
-            return RC_SEEK_FAILED;
+    int done = 0;
+    while (done < numPages) {
+        int batch = numPages - done < IOV_MAX ? numPages - done : IOV_MAX;
+        for (int i = 0; i < batch; i++) {
+            iov[i].iov_base = memPages[done + i];
+            iov[i].iov_len = PAGE_SIZE;
+        }
+        off_t offset = (off_t)(pageNum + done + 1) * PAGE_SIZE;
+        struct iovec *cur = iov;
+        int left = batch;
+        while (left > 0) {
+            ssize_t written = pwritev(info->fd, cur, left, offset);
+            if (written < 0 && errno == EINTR) {
+                continue;
             }
-            ssize_t bytes_written = write(fileno(fp), memPage, PAGE_SIZE);
-            if (bytes_written != PAGE_SIZE) {
+            if (written <= 0) {
                 return RC_WRITE_FAILED;
             }
-            fHandle->curPagePos = pageNum;
-
-            return RC_OK;
+            offset += written;
+            while (left > 0 && (size_t)written >= cur->iov_len) {
+                written -= cur->iov_len;
+                cur++;
+                left--;
+            }
+            if (left > 0) {
+                cur->iov_base = (char *)cur->iov_base + written;
+                cur->iov_len -= written;
+            }
+        }
+        done += batch;
+    }
+    __atomic_store_n(&fHandle->curPagePos, pageNum + numPages - 1, __ATOMIC_RELAXED);
+    return RC_OK;
 }
 
 // Define write current block 
@@ -313,37 +706,13 @@ RC writeCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
 
 // Define append and empty block
 RC appendEmptyBlock(SM_FileHandle *fHandle) {
-    FILE *fp = fHandle->mgmtInfo;
-    char *pageData;
-    int FILE_RC;
-    const int maxWriteTrial = 2;
-    int Action = 0;
-    int SuccessStatus = 0;
-    pageData = (char *)calloc(PAGE_SIZE, sizeof(char));
-    if (pageData == NULL) {
-        return RC_MEMORY_ALLOCATION_FAIL;
-    }
-    if (fp == NULL) {
-        free(pageData);
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
         return RC_FILE_HANDLE_NOT_INIT;
     }
-    FILE_RC = fseek(fp, 0, SEEK_END);
-    if (FILE_RC != 0) {
-        free(pageData);
-        return RC_SEEK_FAILED;
+    RC rc = ensureCapacity(fHandle->totalNumPages + 1, fHandle);
+    if (rc != RC_OK) {
+        return rc;
     }
-    for (Action = 0; Action < maxWriteTrial; Action++) {
-        FILE_RC = fwrite(pageData, PAGE_SIZE, 1, fp);
-        if (FILE_RC == 1) {
-            SuccessStatus = 1;
-            break;
-        }
-    }
-    free(pageData);
-    if (!SuccessStatus) {
-        return RC_WRITE_FAILED;
-    }
-    fHandle->totalNumPages += 1;
     fHandle->curPagePos = fHandle->totalNumPages - 1;
     return RC_OK;
 }
@@ -353,21 +722,956 @@ RC ensureCapacity(int allPagesCount, SM_FileHandle *fHandle) {
     if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
         return RC_FILE_HANDLE_NOT_INIT;
     }
+    SM_FileInfo *info = fHandle->mgmtInfo;
     int activePageCount = fHandle->totalNumPages;
     if (allPagesCount <= activePageCount) {
         return RC_OK;
     }
-    int IncrementPageCount = allPagesCount - activePageCount;
-    int FILE_RC, i;
-    for (i = 0; i < IncrementPageCount; i++) {
-        FILE_RC = appendEmptyBlock(fHandle);
+    if (info->map != NULL) {
+        return RC_WRITE_FAILED;
+    }
+    if (info->compressed) {
+        // new pages read as zeros until written, nothing to allocate on disk
+        pthread_mutex_lock(&info->mapLock);
+        RC rc = growSlotMap(info, allPagesCount);
+        if (rc == RC_OK) {
+            rc = syncSlotMap(info, allPagesCount, 0, 0);
+        }
+        pthread_mutex_unlock(&info->mapLock);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        info->allocatedPages = allPagesCount;
+    } else if (allPagesCount > info->allocatedPages) {
+        int extent = info->allocatedPages;
+        if (extent < MIN_EXTENT_PAGES) {
+            extent = MIN_EXTENT_PAGES;
+        } else if (extent > MAX_EXTENT_PAGES) {
+            extent = MAX_EXTENT_PAGES;
+        }
+        int target = info->allocatedPages + extent;
+        if (target < allPagesCount) {
+            target = allPagesCount;
+        }
+        RC FILE_RC = zeroPages(info, info->allocatedPages, target - info->allocatedPages);
         if (FILE_RC != RC_OK) {
             return FILE_RC;
         }
+        info->allocatedPages = target;
+    }
+    // the pages are already zeroed on disk, growing is only bookkeeping now
+    __atomic_store_n(&fHandle->totalNumPages, allPagesCount, __ATOMIC_RELEASE);
+    return RC_OK;
+}
+
+
+
+
+
+// Helper function, reads one page at offset. A direct handle bounces through
+// an aligned buffer when the caller's page is not aligned
+static RC readPageAt(SM_FileInfo *info, off_t offset, SM_PageHandle memPage) {
+    char *buffer = memPage;
+    size_t done = 0;
+    if (info->map != NULL) {
+        if ((size_t)offset + PAGE_SIZE > info->mapBytes) {
+            return RC_READ_FAILED;
+        }
+        memcpy(memPage, info->map + offset, PAGE_SIZE);
+        return RC_OK;
+    }
+    if (info->direct && (uintptr_t)memPage % DIRECT_IO_ALIGNMENT != 0 &&
+        posix_memalign((void **)&buffer, DIRECT_IO_ALIGNMENT, PAGE_SIZE) != 0) {
+        return RC_MEMORY_ALLOCATION_FAIL;
+    }
+    done = preadFully(info->fd, buffer, PAGE_SIZE, offset);
+    if (buffer != memPage) {
+        if (done == PAGE_SIZE) {
+            memcpy(memPage, buffer, PAGE_SIZE);
+        }
+        free(buffer);
+    }
+    return done == PAGE_SIZE ? RC_OK : RC_READ_FAILED;
+}
+
+// Helper function, zeroes and allocates a run of data pages in one call. Where
+// the file system cannot zero a range, stale pages before the end of file are
+// overwritten in ZERO_FILL_PAGES writes and the rest is added by ftruncate
+static RC zeroPages(SM_FileInfo *info, int firstPage, int numPages) {
+    off_t offset = (off_t)(firstPage + 1) * PAGE_SIZE;
+    off_t length = (off_t)numPages * PAGE_SIZE;
+    struct stat st;
+    if (fallocate(info->fd, FALLOC_FL_ZERO_RANGE, offset, length) == 0) {
+        return RC_OK;
+    }
+    if (fstat(info->fd, &st) != 0) {
+        return RC_WRITE_FAILED;
+    }
+    if (offset + length > st.st_size) {
+        if (ftruncate(info->fd, offset + length) != 0) {
+            return RC_WRITE_FAILED;
+        }
+        length = st.st_size > offset ? st.st_size - offset : 0;
+    }
+    char *zeros;
+    if (posix_memalign((void **)&zeros, DIRECT_IO_ALIGNMENT, ZERO_FILL_PAGES * PAGE_SIZE) != 0) {
+        return RC_MEMORY_ALLOCATION_FAIL;
+    }
+    memset(zeros, 0, ZERO_FILL_PAGES * PAGE_SIZE);
+    RC rc = RC_OK;
+    while (length > 0 && rc == RC_OK) {
+        size_t chunk = length < ZERO_FILL_PAGES * PAGE_SIZE ? length : ZERO_FILL_PAGES * PAGE_SIZE;
+        ssize_t written = pwrite(info->fd, zeros, chunk, offset);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            rc = RC_WRITE_FAILED;
+            break;
+        }
+        offset += written;
+        length -= written;
+    }
+    free(zeros);
+    return rc;
+}
+
+// Helper function, the write counterpart of readPageAt
+static RC writePageAt(SM_FileInfo *info, off_t offset, SM_PageHandle memPage) {
+    char *buffer = memPage;
+    size_t done = 0;
+    if (info->map != NULL) {
+        return RC_WRITE_FAILED;
+    }
+    if (info->direct && (uintptr_t)memPage % DIRECT_IO_ALIGNMENT != 0) {
+        if (posix_memalign((void **)&buffer, DIRECT_IO_ALIGNMENT, PAGE_SIZE) != 0) {
+            return RC_MEMORY_ALLOCATION_FAIL;
+        }
+        memcpy(buffer, memPage, PAGE_SIZE);
+    }
+    done = pwriteFully(info->fd, buffer, PAGE_SIZE, offset);
+    if (buffer != memPage) {
+        free(buffer);
+    }
+    return done == PAGE_SIZE ? RC_OK : RC_WRITE_FAILED;
+}
+
+// Define set up an asynchronous read queue
+RC initAsyncIO(SM_AsyncIO *aio, int queueDepth, int flags) {
+    if (aio == NULL || queueDepth <= 0) {
+        return RC_ERROR;
+    }
+    SM_AsyncEngine *engine = (SM_AsyncEngine *) calloc(1, sizeof(SM_AsyncEngine));
+    if (engine == NULL) {
+        return RC_MEMORY_ALLOCATION_FAIL;
+    }
+    engine->ringFd = -1;
+    pthread_mutex_init(&engine->lock, NULL);
+    pthread_cond_init(&engine->workAvailable, NULL);
+    pthread_cond_init(&engine->workDone, NULL);
+    if (!(flags & SM_ASYNC_THREAD_POOL)) {
+        setupRing(engine, queueDepth);
+    }
+    if (engine->ringFd == -1) {
+        for (int i = 0; i < ASYNC_WORKER_THREADS; i++) {
+            if (pthread_create(&engine->workers[i], NULL, asyncWorkerMain, engine) != 0) {
+                break;
+            }
+            engine->numWorkers++;
+        }
+        if (engine->numWorkers == 0) {
+            pthread_mutex_destroy(&engine->lock);
+            pthread_cond_destroy(&engine->workAvailable);
+            pthread_cond_destroy(&engine->workDone);
+            free(engine);
+            return RC_ERROR;
+        }
+    }
+    aio->queueDepth = queueDepth;
+    aio->inFlight = 0;
+    aio->mgmtInfo = engine;
+    return RC_OK;
+}
+
+// Define drain and tear down an asynchronous read queue
+RC shutdownAsyncIO(SM_AsyncIO *aio) {
+    if (aio == NULL || aio->mgmtInfo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_AsyncEngine *engine = aio->mgmtInfo;
+    while (aio->inFlight > 0) {
+        pollAsyncIO(aio, aio->inFlight);
+    }
+    if (engine->ringFd != -1) {
+        munmap(engine->sqes, engine->sqesBytes);
+        munmap(engine->sqRing, engine->sqRingBytes);
+        if (engine->cqRing != engine->sqRing) {
+            munmap(engine->cqRing, engine->cqRingBytes);
+        }
+        close(engine->ringFd);
+    }
+    pthread_mutex_lock(&engine->lock);
+    engine->stopping = 1;
+    pthread_cond_broadcast(&engine->workAvailable);
+    pthread_mutex_unlock(&engine->lock);
+    for (int i = 0; i < engine->numWorkers; i++) {
+        pthread_join(engine->workers[i], NULL);
+    }
+    pthread_mutex_destroy(&engine->lock);
+    pthread_cond_destroy(&engine->workAvailable);
+    pthread_cond_destroy(&engine->workDone);
+    free(engine);
+    aio->mgmtInfo = NULL;
+    return RC_OK;
+}
+
+// Define queue the read of one page
+RC submitRead(SM_AsyncIO *aio, SM_FileHandle *fHandle, int pageNum,
+        SM_PageHandle memPage, SM_ReadCallback cb, void *arg) {
+    if (aio == NULL || aio->mgmtInfo == NULL || fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (pageNum < 0 || pageNum >= __atomic_load_n(&fHandle->totalNumPages, __ATOMIC_ACQUIRE)) {
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+    SM_AsyncEngine *engine = aio->mgmtInfo;
+    while (aio->inFlight >= aio->queueDepth) {
+        pollAsyncIO(aio, 1);
+    }
+    SM_AsyncRequest *req = (SM_AsyncRequest *) calloc(1, sizeof(SM_AsyncRequest));
+    if (req == NULL) {
+        return RC_MEMORY_ALLOCATION_FAIL;
+    }
+    req->info = fHandle->mgmtInfo;
+    req->pageNum = pageNum;
+    req->memPage = memPage;
+    req->cb = cb;
+    req->arg = arg;
+    req->iov.iov_base = memPage;
+    req->iov.iov_len = PAGE_SIZE;
+    aio->inFlight++;
+
+    if (req->info->compressed) {
+        // a slot is a few hundred bytes, decompressing it is not worth a round trip
+        req->rc = readCompressedPage(req->info, pageNum, memPage);
+        pushRequest(&engine->doneHead, &engine->doneTail, req, engine);
+        return RC_OK;
+    }
+    if (req->info->map != NULL || (req->info->direct && (uintptr_t)memPage % DIRECT_IO_ALIGNMENT != 0)) {
+        // mapped pages are a copy away; unaligned direct reads need a bounce
+        req->rc = readPageAt(req->info, (off_t)(pageNum + 1) * PAGE_SIZE, memPage);
+        pushRequest(&engine->doneHead, &engine->doneTail, req, engine);
+        return RC_OK;
+    }
+    if (engine->ringFd != -1) {
+        unsigned tail = *engine->sqTail;
+        unsigned index = tail & *engine->sqMask;
+        struct io_uring_sqe *sqe = &engine->sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READV;
+        sqe->fd = req->info->fd;
+        sqe->addr = (unsigned long) &req->iov;
+        sqe->len = 1;
+        sqe->off = (off_t)(pageNum + 1) * PAGE_SIZE;
+        sqe->user_data = (unsigned long) req;
+        engine->sqArray[index] = index;
+        __atomic_store_n(engine->sqTail, tail + 1, __ATOMIC_RELEASE);
+        if (syscall(__NR_io_uring_enter, engine->ringFd, 1, 0, 0, NULL, 0) != 1) {
+            // take the entry back and fail the read through the normal path
+            __atomic_store_n(engine->sqTail, tail, __ATOMIC_RELEASE);
+            req->rc = RC_READ_FAILED;
+            pushRequest(&engine->doneHead, &engine->doneTail, req, engine);
+        }
+        return RC_OK;
     }
+    pushRequest(&engine->todoHead, &engine->todoTail, req, engine);
     return RC_OK;
 }
 
+// Define run the callbacks of finished reads
+int pollAsyncIO(SM_AsyncIO *aio, int minComplete) {
+    if (aio == NULL || aio->mgmtInfo == NULL) {
+        return 0;
+    }
+    SM_AsyncEngine *engine = aio->mgmtInfo;
+    int completed = 0;
+    if (minComplete > aio->inFlight) {
+        minComplete = aio->inFlight;
+    }
+    for (;;) {
+        pthread_mutex_lock(&engine->lock);
+        SM_AsyncRequest *done = engine->doneHead;
+        engine->doneHead = engine->doneTail = NULL;
+        pthread_mutex_unlock(&engine->lock);
+        while (done != NULL) {
+            SM_AsyncRequest *next = done->next;
+            completeRequest(aio, done);
+            completed++;
+            done = next;
+        }
+        if (engine->ringFd != -1) {
+            unsigned head = *engine->cqHead;
+            while (head != __atomic_load_n(engine->cqTail, __ATOMIC_ACQUIRE)) {
+                struct io_uring_cqe *cqe = &engine->cqes[head & *engine->cqMask];
+                SM_AsyncRequest *req = (SM_AsyncRequest *)(uintptr_t) cqe->user_data;
+                req->rc = cqe->res == PAGE_SIZE ? RC_OK : RC_READ_FAILED;
+                head++;
+                __atomic_store_n(engine->cqHead, head, __ATOMIC_RELEASE);
+                completeRequest(aio, req);
+                completed++;
+            }
+        }
+        if (completed >= minComplete || aio->inFlight == 0) {
+            return completed;
+        }
+        if (engine->ringFd != -1) {
+            syscall(__NR_io_uring_enter, engine->ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        } else {
+            pthread_mutex_lock(&engine->lock);
+            while (engine->doneHead == NULL) {
+                pthread_cond_wait(&engine->workDone, &engine->lock);
+            }
+            pthread_mutex_unlock(&engine->lock);
+        }
+    }
+}
 
+// Helper function, maps the submission and completion rings; leaves ringFd
+// at -1 when io_uring is not available so the caller falls back to threads
+static void setupRing(SM_AsyncEngine *engine, int queueDepth) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = syscall(__NR_io_uring_setup, queueDepth, &params);
+    if (fd < 0) {
+        return;
+    }
+    engine->sqRingBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    engine->cqRingBytes = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (engine->cqRingBytes > engine->sqRingBytes) {
+            engine->sqRingBytes = engine->cqRingBytes;
+        }
+        engine->cqRingBytes = engine->sqRingBytes;
+    }
+    engine->sqRing = mmap(NULL, engine->sqRingBytes, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (engine->sqRing == MAP_FAILED) {
+        close(fd);
+        return;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        engine->cqRing = engine->sqRing;
+    } else {
+        engine->cqRing = mmap(NULL, engine->cqRingBytes, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (engine->cqRing == MAP_FAILED) {
+            munmap(engine->sqRing, engine->sqRingBytes);
+            close(fd);
+            return;
+        }
+    }
+    engine->sqesBytes = params.sq_entries * sizeof(struct io_uring_sqe);
+    engine->sqes = mmap(NULL, engine->sqesBytes, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (engine->sqes == MAP_FAILED) {
+        if (engine->cqRing != engine->sqRing) {
+            munmap(engine->cqRing, engine->cqRingBytes);
+        }
+        munmap(engine->sqRing, engine->sqRingBytes);
+        close(fd);
+        return;
+    }
+    char *sq = engine->sqRing;
+    char *cq = engine->cqRing;
+    engine->sqHead = (unsigned *)(sq + params.sq_off.head);
+    engine->sqTail = (unsigned *)(sq + params.sq_off.tail);
+    engine->sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+    engine->sqArray = (unsigned *)(sq + params.sq_off.array);
+    engine->cqHead = (unsigned *)(cq + params.cq_off.head);
+    engine->cqTail = (unsigned *)(cq + params.cq_off.tail);
+    engine->cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+    engine->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    engine->ringFd = fd;
+}
 
+// Helper function, fallback reader thread
+static void *asyncWorkerMain(void *arg) {
+    SM_AsyncEngine *engine = arg;
+    pthread_mutex_lock(&engine->lock);
+    for (;;) {
+        while (engine->todoHead == NULL && !engine->stopping) {
+            pthread_cond_wait(&engine->workAvailable, &engine->lock);
+        }
+        if (engine->todoHead == NULL) {
+            break;
+        }
+        SM_AsyncRequest *req = engine->todoHead;
+        engine->todoHead = req->next;
+        if (engine->todoHead == NULL) {
+            engine->todoTail = NULL;
+        }
+        req->next = NULL;
+        pthread_mutex_unlock(&engine->lock);
+        req->rc = readPageAt(req->info, (off_t)(req->pageNum + 1) * PAGE_SIZE, req->memPage);
+        pthread_mutex_lock(&engine->lock);
+        if (engine->doneTail != NULL) {
+            engine->doneTail->next = req;
+        } else {
+            engine->doneHead = req;
+        }
+        engine->doneTail = req;
+        pthread_cond_signal(&engine->workDone);
+    }
+    pthread_mutex_unlock(&engine->lock);
+    return NULL;
+}
 
+// Helper function, appends to one of the engine's request lists
+static void pushRequest(SM_AsyncRequest **head, SM_AsyncRequest **tail, SM_AsyncRequest *req, SM_AsyncEngine *engine) {
+    pthread_mutex_lock(&engine->lock);
+    req->next = NULL;
+    if (*tail != NULL) {
+        (*tail)->next = req;
+    } else {
+        *head = req;
+    }
+    *tail = req;
+    if (head == &engine->todoHead) {
+        pthread_cond_signal(&engine->workAvailable);
+    } else {
+        pthread_cond_signal(&engine->workDone);
+    }
+    pthread_mutex_unlock(&engine->lock);
+}
+
+// Helper function
+static void completeRequest(SM_AsyncIO *aio, SM_AsyncRequest *req) {
+    aio->inFlight--;
+    if (req->rc == RC_OK) {
+        req->rc = verifyPageChecksum(req->memPage);
+    }
+    if (req->cb != NULL) {
+        req->cb(req->memPage, req->pageNum, req->rc, req->arg);
+    }
+    free(req);
+}
+
+// Define stamp a page with the checksum of its data
+void setPageChecksum(SM_PageHandle memPage) {
+    uint32_t checksum = pageChecksum(memPage);
+    memcpy(memPage + PAGE_DATA_SIZE, &checksum, PAGE_CHECKSUM_SIZE);
+}
+
+// Define check a page against its checksum
+RC verifyPageChecksum(SM_PageHandle memPage) {
+    uint32_t stored;
+    memcpy(&stored, memPage + PAGE_DATA_SIZE, PAGE_CHECKSUM_SIZE);
+    if (stored == pageChecksum(memPage)) {
+        return RC_OK;
+    }
+    return RC_CHECKSUM_FAILED;
+}
+
+// Helper function, CRC32C of the page data relative to that of a zero page,
+// so a page that is all zeros, trailer included, carries a valid checksum
+static uint32_t pageChecksum(SM_PageHandle memPage) {
+    uint32_t checksum = crc32c(memPage, PAGE_DATA_SIZE);
+    return checksum ^ zeroPageCrc;
+}
+
+// Helper function
+static void initCrc32c(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        }
+        crc32cTable[i] = crc;
+    }
+    uint32_t crc = 0xFFFFFFFFu;
+    for (int i = 0; i < PAGE_DATA_SIZE; i++) {
+        crc = crc32cTable[crc & 0xFF] ^ (crc >> 8);
+    }
+    zeroPageCrc = ~crc;
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    crc32cHardware = __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+#if defined(__x86_64__)
+// Helper function, eight bytes per crc32 instruction
+__attribute__((target("sse4.2")))
+static uint32_t crc32cSse42(uint32_t crc, const unsigned char *data, size_t length) {
+    uint64_t crc64 = crc;
+    while (length >= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, data, 8);
+        crc64 = _mm_crc32_u64(crc64, chunk);
+        data += 8;
+        length -= 8;
+    }
+    crc = (uint32_t)crc64;
+    while (length > 0) {
+        crc = _mm_crc32_u8(crc, *data++);
+        length--;
+    }
+    return crc;
+}
+#endif
+
+// Helper function, CRC32C with the SSE4.2 instruction when the CPU has it
+static uint32_t crc32c(const void *data, size_t length) {
+    const unsigned char *bytes = data;
+    uint32_t crc = 0xFFFFFFFFu;
+    pthread_once(&crc32cOnce, initCrc32c);
+#if defined(__x86_64__)
+    if (crc32cHardware) {
+        return ~crc32cSse42(crc, bytes, length);
+    }
+#endif
+    while (length > 0) {
+        crc = crc32cTable[(crc ^ *bytes++) & 0xFF] ^ (crc >> 8);
+        length--;
+    }
+    return ~crc;
+}
+
+// Helper function, preads until length bytes arrived, EOF or an error;
+// returns how many bytes were read
+static size_t preadFully(int fd, char *buffer, size_t length, off_t offset) {
+    size_t done = 0;
+    while (done < length) {
+        ssize_t bytes_read = pread(fd, buffer + done, length - done, offset + done);
+        if (bytes_read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_read <= 0) {
+            break;
+        }
+        done += bytes_read;
+    }
+    return done;
+}
+
+// Helper function, the write counterpart of preadFully
+static size_t pwriteFully(int fd, const char *buffer, size_t length, off_t offset) {
+    size_t done = 0;
+    while (done < length) {
+        ssize_t bytes_written = pwrite(fd, buffer + done, length - done, offset + done);
+        if (bytes_written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_written <= 0) {
+            break;
+        }
+        done += bytes_written;
+    }
+    return done;
+}
+
+// Helper function, fills the header page: the page count as text and, for a
+// compressed file, where its indirection map is stored
+static void formatHeader(char *pageData, int totalNumPages, SM_FileInfo *info) {
+    memset(pageData, 0, PAGE_SIZE);
+    sprintf(pageData, "%d", totalNumPages);
+    if (info->compressed) {
+        SM_CompressedHeader header;
+        memcpy(header.magic, COMPRESSED_MAGIC, sizeof(header.magic));
+        header.mapUnit = info->mapUnit;
+        header.numSlots = totalNumPages;
+        header.mapCapacity = info->mapCapacity;
+        memcpy(pageData + COMPRESSED_HEADER_OFFSET, &header, sizeof(header));
+    }
+}
+
+// Helper function, rewrites the header page of a compressed file
+static RC writeHeaderPage(SM_FileInfo *info, int totalNumPages) {
+    char pageData[PAGE_SIZE] __attribute__((aligned(DIRECT_IO_ALIGNMENT)));
+    formatHeader(pageData, totalNumPages, info);
+    RC rc = writePageAt(info, 0, pageData);
+    if (rc == RC_OK) {
+        info->storedPages = totalNumPages;
+    }
+    return rc;
+}
+
+// Helper function, reads the indirection map of a compressed file and finds
+// the free space between its slots
+static RC loadSlotMap(SM_FileInfo *info, const char *pageData, int totalNumPages) {
+    SM_CompressedHeader header;
+    memcpy(&header, pageData + COMPRESSED_HEADER_OFFSET, sizeof(header));
+    if (totalNumPages < 0 || header.numSlots != (uint32_t)totalNumPages ||
+        header.mapCapacity < header.numSlots) {
+        return RC_INVALID_HEADER;
+    }
+    info->compressed = 1;
+    info->mapUnit = header.mapUnit;
+    info->mapCapacity = header.mapCapacity;
+    info->storedPages = totalNumPages;
+    RC rc = growSlotMap(info, totalNumPages);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    off_t offset = PAGE_SIZE + (off_t)header.mapUnit * SLOT_UNIT;
+    size_t mapBytes = (size_t)totalNumPages * sizeof(SM_PageSlot);
+    if (preadFully(info->fd, (char *)info->slots, mapBytes, offset) != mapBytes) {
+        return RC_INVALID_HEADER;
+    }
+    return findFreeSlots(info, totalNumPages);
+}
+
+// Helper function, every unit that neither a page nor the map occupies is
+// free; the slots end where the last of them does
+static RC findFreeSlots(SM_FileInfo *info, int totalNumPages) {
+    SM_UnitRange *used = (SM_UnitRange *) malloc((totalNumPages + 1) * sizeof(SM_UnitRange));
+    int numUsed = 0;
+    RC rc = RC_OK;
+    if (used == NULL) {
+        return RC_MEMORY_ALLOCATION_FAIL;
+    }
+    for (int p = 0; p < totalNumPages; p++) {
+        if (info->slots[p].units > 0) {
+            used[numUsed].unit = info->slots[p].unit;
+            used[numUsed].units = info->slots[p].units;
+            numUsed++;
+        }
+    }
+    if (info->mapCapacity > 0) {
+        used[numUsed].unit = info->mapUnit;
+        used[numUsed].units = (info->mapCapacity * sizeof(SM_PageSlot) + SLOT_UNIT - 1) / SLOT_UNIT;
+        numUsed++;
+    }
+    qsort(used, numUsed, sizeof(SM_UnitRange), compareUnitRanges);
+    uint32_t end = 0;
+    for (int i = 0; i < numUsed && rc == RC_OK; i++) {
+        if (used[i].unit > end) {
+            rc = addFreeUnits(&info->freeSlots, &info->numFreeSlots, &info->freeSlotCapacity,
+                              end, used[i].unit - end);
+        }
+        if (used[i].unit + used[i].units > end) {
+            end = used[i].unit + used[i].units;
+        }
+    }
+    info->dataUnits = end;
+    free(used);
+    return rc;
+}
+
+// Helper function, orders unit ranges by where they start
+static int compareUnitRanges(const void *left, const void *right) {
+    const SM_UnitRange *l = left;
+    const SM_UnitRange *r = right;
+    return (l->unit > r->unit) - (l->unit < r->unit);
+}
+
+// Helper function, writes the map entries of numPages pages from firstPage
+// and the header page when the page count changed, moving the map first if
+// the file outgrew its region. Afterwards nothing on disk points at the
+// pending slots any more and they become free
+static RC syncSlotMap(SM_FileInfo *info, int totalNumPages, int firstPage, int numPages) {
+    RC rc = RC_OK;
+    if ((uint32_t)totalNumPages > info->mapCapacity) {
+        rc = moveSlotMap(info, totalNumPages);
+    } else {
+        off_t offset = PAGE_SIZE + (off_t)info->mapUnit * SLOT_UNIT + (off_t)firstPage * sizeof(SM_PageSlot);
+        size_t bytes = (size_t)numPages * sizeof(SM_PageSlot);
+        if (bytes > 0 && pwriteFully(info->fd, (const char *)(info->slots + firstPage), bytes, offset) != bytes) {
+            rc = RC_WRITE_FAILED;
+        }
+        if (rc == RC_OK && info->storedPages != totalNumPages) {
+            rc = writeHeaderPage(info, totalNumPages);
+        }
+    }
+    for (int i = 0; rc == RC_OK && i < info->numPendingSlots; i++) {
+        rc = addFreeUnits(&info->freeSlots, &info->numFreeSlots, &info->freeSlotCapacity,
+                          info->pendingSlots[i].unit, info->pendingSlots[i].units);
+    }
+    if (rc == RC_OK) {
+        info->numPendingSlots = 0;
+    }
+    return rc;
+}
+
+// Helper function, writes the whole map to a region twice as large past the
+// last slot and points the header there; the old region is released once the
+// header no longer names it
+static RC moveSlotMap(SM_FileInfo *info, int totalNumPages) {
+    uint32_t capacity = info->mapCapacity < MIN_EXTENT_PAGES ? MIN_EXTENT_PAGES : info->mapCapacity;
+    while (capacity < (uint32_t)totalNumPages) {
+        capacity *= 2;
+    }
+    RC rc = growSlotMap(info, capacity);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    uint32_t unit = info->dataUnits;
+    uint32_t units = (capacity * sizeof(SM_PageSlot) + SLOT_UNIT - 1) / SLOT_UNIT;
+    off_t offset = PAGE_SIZE + (off_t)unit * SLOT_UNIT;
+    size_t bytes = (size_t)capacity * sizeof(SM_PageSlot);
+    if (pwriteFully(info->fd, (const char *)info->slots, bytes, offset) != bytes) {
+        return RC_WRITE_FAILED;
+    }
+    info->dataUnits += units;
+    uint32_t oldUnit = info->mapUnit;
+    uint32_t oldUnits = (info->mapCapacity * sizeof(SM_PageSlot) + SLOT_UNIT - 1) / SLOT_UNIT;
+    info->mapUnit = unit;
+    info->mapCapacity = capacity;
+    rc = writeHeaderPage(info, totalNumPages);
+    if (rc == RC_OK && oldUnits > 0) {
+        rc = addFreeUnits(&info->pendingSlots, &info->numPendingSlots, &info->pendingSlotCapacity,
+                          oldUnit, oldUnits);
+    }
+    return rc;
+}
+
+// Helper function, appends a run of units to a slot list in pieces no larger
+// than one page needs
+static RC addFreeUnits(SM_PageSlot **list, int *count, int *capacity, uint32_t unit, uint32_t units) {
+    while (units > 0) {
+        if (*count == *capacity) {
+            int newCapacity = *capacity ? *capacity * 2 : MIN_EXTENT_PAGES;
+            SM_PageSlot *slots = (SM_PageSlot *) realloc(*list, newCapacity * sizeof(SM_PageSlot));
+            if (slots == NULL) {
+                return RC_MEMORY_ALLOCATION_FAIL;
+            }
+            *list = slots;
+            *capacity = newCapacity;
+        }
+        uint32_t piece = units < MAX_SLOT_UNITS ? units : MAX_SLOT_UNITS;
+        (*list)[*count].unit = unit;
+        (*list)[*count].length = 0;
+        (*list)[*count].units = piece;
+        (*count)++;
+        unit += piece;
+        units -= piece;
+    }
+    return RC_OK;
+}
+
+// Helper function, makes room in the indirection map for numPages pages
+static RC growSlotMap(SM_FileInfo *info, int numPages) {
+    if (numPages <= info->slotCapacity) {
+        return RC_OK;
+    }
+    int capacity = info->slotCapacity < MIN_EXTENT_PAGES ? MIN_EXTENT_PAGES : info->slotCapacity;
+    while (capacity < numPages) {
+        capacity *= 2;
+    }
+    SM_PageSlot *slots = (SM_PageSlot *) realloc(info->slots, capacity * sizeof(SM_PageSlot));
+    if (slots == NULL) {
+        return RC_MEMORY_ALLOCATION_FAIL;
+    }
+    memset(slots + info->slotCapacity, 0, (capacity - info->slotCapacity) * sizeof(SM_PageSlot));
+    info->slots = slots;
+    info->slotCapacity = capacity;
+    return RC_OK;
+}
+
+// Helper function
+static void freeSlotMap(SM_FileInfo *info) {
+    free(info->slots);
+    free(info->freeSlots);
+    free(info->pendingSlots);
+    info->slots = info->freeSlots = info->pendingSlots = NULL;
+    info->slotCapacity = info->freeSlotCapacity = info->numFreeSlots = 0;
+    info->pendingSlotCapacity = info->numPendingSlots = 0;
+}
+
+// Helper function, reads and decompresses one page of a compressed file
+static RC readCompressedPage(SM_FileInfo *info, int pageNum, SM_PageHandle memPage) {
+    pthread_mutex_lock(&info->mapLock);
+    SM_PageSlot slot = info->slots[pageNum];
+    pthread_mutex_unlock(&info->mapLock);
+    unsigned char packed[PAGE_SIZE];
+    if (slot.length == 0) {
+        memset(memPage, 0, PAGE_SIZE);
+        return RC_OK;
+    }
+    off_t offset = PAGE_SIZE + (off_t)slot.unit * SLOT_UNIT;
+    if (slot.length == PAGE_SIZE) {
+        return preadFully(info->fd, memPage, PAGE_SIZE, offset) == PAGE_SIZE ? RC_OK : RC_READ_FAILED;
+    }
+    if (preadFully(info->fd, (char *)packed, slot.length, offset) != slot.length) {
+        return RC_READ_FAILED;
+    }
+    if (lzDecompress(packed, slot.length, (unsigned char *)memPage, PAGE_SIZE) != 0) {
+        return RC_CHECKSUM_FAILED;
+    }
+    return RC_OK;
+}
+
+// Helper function, compresses one page into its slot. A page that no longer
+// fits moves to a free slot that is big enough or to the end of the file; the
+// slot it leaves stays pending until the map is written
+static RC writeCompressedPage(SM_FileInfo *info, int pageNum, SM_PageHandle memPage) {
+    unsigned char packed[PAGE_SIZE];
+    // compression has to save at least one unit to be worth a decompress
+    int length = lzCompress((const unsigned char *)memPage, PAGE_SIZE, packed, PAGE_SIZE - SLOT_UNIT);
+    const char *data = (const char *)packed;
+    if (length == 0) {
+        length = PAGE_SIZE;
+        data = memPage;
+    }
+    int units = (length + SLOT_UNIT - 1) / SLOT_UNIT;
+    SM_PageSlot *slot = &info->slots[pageNum];
+    if (slot->units < units) {
+        int best = -1;
+        for (int i = 0; i < info->numFreeSlots; i++) {
+            if (info->freeSlots[i].units >= units &&
+                (best == -1 || info->freeSlots[i].units < info->freeSlots[best].units)) {
+                best = i;
+            }
+        }
+        SM_PageSlot released = *slot;
+        if (best != -1) {
+            slot->unit = info->freeSlots[best].unit;
+            slot->units = info->freeSlots[best].units;
+            info->freeSlots[best] = info->freeSlots[--info->numFreeSlots];
+        } else {
+            slot->unit = info->dataUnits;
+            slot->units = units;
+            info->dataUnits += units;
+        }
+        if (released.units > 0) {
+            RC rc = addFreeUnits(&info->pendingSlots, &info->numPendingSlots, &info->pendingSlotCapacity,
+                                 released.unit, released.units);
+            if (rc != RC_OK) {
+                return rc;
+            }
+        }
+    }
+    off_t offset = PAGE_SIZE + (off_t)slot->unit * SLOT_UNIT;
+    if (pwriteFully(info->fd, data, length, offset) != (size_t)length) {
+        return RC_WRITE_FAILED;
+    }
+    slot->length = length;
+    return RC_OK;
+}
+
+// Helper function, appends one LZ sequence: literals, then a back reference
+// unless matchLength is 0, which marks the last sequence of a block
+static int lzEmitSequence(unsigned char *dst, int dstCapacity, int *op,
+        const unsigned char *literals, int numLiterals, int offset, int matchLength) {
+    int out = *op;
+    int extraMatch = matchLength > 0 ? matchLength - LZ_MIN_MATCH : 0;
+    if (out + 1 + numLiterals / 255 + 1 + numLiterals + 2 + extraMatch / 255 + 1 > dstCapacity) {
+        return 0;
+    }
+    unsigned char *token = &dst[out++];
+    *token = (numLiterals >= 15 ? 15 : numLiterals) << 4;
+    if (numLiterals >= 15) {
+        int rest = numLiterals - 15;
+        for (; rest >= 255; rest -= 255) {
+            dst[out++] = 255;
+        }
+        dst[out++] = rest;
+    }
+    memcpy(&dst[out], literals, numLiterals);
+    out += numLiterals;
+    if (matchLength > 0) {
+        dst[out++] = offset & 0xFF;
+        dst[out++] = offset >> 8;
+        *token |= extraMatch >= 15 ? 15 : extraMatch;
+        if (extraMatch >= 15) {
+            int rest = extraMatch - 15;
+            for (; rest >= 255; rest -= 255) {
+                dst[out++] = 255;
+            }
+            dst[out++] = rest;
+        }
+    }
+    *op = out;
+    return 1;
+}
+
+// Helper function, greedy LZ compression with a single hash probe per
+// position; returns the compressed length, or 0 when it exceeds dstCapacity
+static int lzCompress(const unsigned char *src, int srcLength, unsigned char *dst, int dstCapacity) {
+    uint16_t table[1 << LZ_HASH_BITS];
+    int ip = 0;
+    int anchor = 0;
+    int op = 0;
+    int matchLimit = srcLength - LZ_LAST_LITERALS;
+    memset(table, 0, sizeof(table));
+    while (ip + LZ_MIN_MATCH <= matchLimit) {
+        uint32_t sequence;
+        memcpy(&sequence, src + ip, sizeof(sequence));
+        uint32_t hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+        int candidate = table[hash];
+        table[hash] = ip;
+        if (candidate >= ip || ip - candidate > 0xFFFF || memcmp(src + candidate, src + ip, LZ_MIN_MATCH) != 0) {
+            ip++;
+            continue;
+        }
+        int length = LZ_MIN_MATCH;
+        while (ip + length < matchLimit && src[candidate + length] == src[ip + length]) {
+            length++;
+        }
+        if (!lzEmitSequence(dst, dstCapacity, &op, src + anchor, ip - anchor, ip - candidate, length)) {
+            return 0;
+        }
+        ip += length;
+        anchor = ip;
+    }
+    if (!lzEmitSequence(dst, dstCapacity, &op, src + anchor, srcLength - anchor, 0, 0)) {
+        return 0;
+    }
+    return op;
+}
+
+// Helper function, returns 0 when src decompresses to exactly dstLength bytes
+// and -1 for anything malformed
+static int lzDecompress(const unsigned char *src, int srcLength, unsigned char *dst, int dstLength) {
+    int ip = 0;
+    int op = 0;
+    while (ip < srcLength) {
+        int token = src[ip++];
+        int numLiterals = token >> 4;
+        if (numLiterals == 15) {
+            int next;
+            do {
+                if (ip >= srcLength) {
+                    return -1;
+                }
+                next = src[ip++];
+                numLiterals += next;
+            } while (next == 255);
+        }
+        if (numLiterals > srcLength - ip || numLiterals > dstLength - op) {
+            return -1;
+        }
+        memcpy(dst + op, src + ip, numLiterals);
+        ip += numLiterals;
+        op += numLiterals;
+        if (ip == srcLength) {
+            break;
+        }
+        if (ip + 2 > srcLength) {
+            return -1;
+        }
+        int offset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        int length = token & 15;
+        if (length == 15) {
+            int next;
+            do {
+                if (ip >= srcLength) {
+                    return -1;
+                }
+                next = src[ip++];
+                length += next;
+            } while (next == 255);
+        }
+        length += LZ_MIN_MATCH;
+        if (offset == 0 || offset > op || length > dstLength - op) {
+            return -1;
+        }
+        // the reference may overlap what it produces, so copy bytewise
+        for (int i = 0; i < length; i++) {
+            dst[op + i] = dst[op - offset + i];
+        }
+        op += length;
+    }
+    return op == dstLength ? 0 : -1;
+}
@@ -20,8 +20,18 @@ typedef char* SM_PageHandle;
  ************************************************************/
 /* manipulating page files */
 extern void initStorageManager (void);
+// non-zero makes openPageFile use O_DIRECT, so the buffer pool is the only cache
+extern void setDirectIO (int enabled);
+// non-zero makes createPageFile create compressed page files. Their pages are
+// LZ compressed into variable sized slots found through an indirection map;
+// readBlock and writeBlock (de)compress transparently. Compressed files are
+// never opened with O_DIRECT and cannot be opened with openPageFileMapped
+extern void setPageCompression (int enabled);
 extern RC createPageFile (char *fileName);
 extern RC openPageFile (char *fileName, SM_FileHandle *fHandle);
+extern RC openPageFileDirect (char *fileName, SM_FileHandle *fHandle);
+// read-only handle backed by mmap; writes on it fail with RC_WRITE_FAILED
+extern RC openPageFileMapped (char *fileName, SM_FileHandle *fHandle);
 extern RC closePageFile (SM_FileHandle *fHandle);
 extern RC destroyPageFile (char *fileName);
 
@@ -33,11 +43,52 @@ extern RC readPreviousBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readNextBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readLastBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
+// points memPage into the mapping of a handle from openPageFileMapped
+extern RC mapBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle *memPage);
+
+/* access pattern hints, madvise for mapped handles and fadvise otherwise */
+#define SM_ADVICE_WILLNEED 0
+#define SM_ADVICE_SEQUENTIAL 1
+#define SM_ADVICE_RANDOM 2
+extern RC adviseBlocks (int firstPage, int numPages, SM_FileHandle *fHandle, int advice);
 
 /* writing blocks to a page file */
 extern RC writeBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
+extern RC writeBlocks (int pageNum, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages);
 extern RC writeCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC appendEmptyBlock (SM_FileHandle *fHandle);
 extern RC ensureCapacity (int numberOfPages, SM_FileHandle *fHandle);
 
+/* page checksums, a CRC32C of the page data kept in its last bytes */
+// writeBlock and writeBlocks stamp every page they write, so callers own only
+// the first PAGE_DATA_SIZE bytes; readBlock verifies every page and fails with
+// RC_CHECKSUM_FAILED when they do not match. A page of zeros is valid, so
+// pages allocated but never written read back fine
+extern void setPageChecksum (SM_PageHandle memPage);
+extern RC verifyPageChecksum (SM_PageHandle memPage);
+
+/* asynchronous reads */
+// run from pollAsyncIO on the polling thread once a submitted read finished
+typedef void (*SM_ReadCallback) (SM_PageHandle memPage, int pageNum, RC rc, void *arg);
+
+typedef struct SM_AsyncIO {
+	int queueDepth;
+	int inFlight;
+	void *mgmtInfo;
+} SM_AsyncIO;
+
+// reads go through io_uring when the kernel allows it and through a small
+// pool of reader threads otherwise; this flag asks for the threads directly
+#define SM_ASYNC_THREAD_POOL 1
+
+extern RC initAsyncIO (SM_AsyncIO *aio, int queueDepth, int flags);
+extern RC shutdownAsyncIO (SM_AsyncIO *aio);
+// queues a read of one page; with queueDepth reads in flight it first polls
+// for a completion, so callbacks of earlier reads may run inside the call
+extern RC submitRead (SM_AsyncIO *aio, SM_FileHandle *fHandle, int pageNum,
+		SM_PageHandle memPage, SM_ReadCallback cb, void *arg);
+// runs the callbacks of finished reads, waiting until at least minComplete
+// of them (or everything in flight) are done; returns how many completed
+extern int pollAsyncIO (SM_AsyncIO *aio, int minComplete);
+
 #endif
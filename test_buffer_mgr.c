@@ -0,0 +1,468 @@
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "dberror.h"
+#include "storage_mgr.h"
+#include "buffer_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "test_helper.h"
+
+#define TEST_FILE "testbuffer.bin"
+#define OTHER_TEST_FILE "testbuffer_other.bin"
+
+// test methods
+static void testChecksumFailure (void);
+static void testResize (void);
+static void testSharedPool (void);
+static void testPinWait (void);
+static void testBackgroundWriter (void);
+static void testPoolStats (void);
+
+// helper methods
+static void fillPages (const char *fileName, int numPages);
+static void overwriteFile (const char *fileName, off_t offset, char value, int length);
+static bool holdsPage (BM_BufferPool *bm, PageNumber pageNum);
+static void writePage (BM_BufferPool *bm, PageNumber pageNum, const char *format);
+static void checkPage (BM_BufferPool *bm, PageNumber pageNum, const char *format);
+static void *pinWaiting (void *arg);
+
+// a pinPageWait running on another thread
+typedef struct PinWaiter {
+  BM_BufferPool *bm;
+  BM_PageHandle h;
+  PageNumber pageNum;
+  RC rc;
+  bool done;
+} PinWaiter;
+
+// test name
+char *testName;
+
+// main method
+int
+main (void)
+{
+  testName = "";
+
+  initStorageManager();
+  testChecksumFailure();
+  testResize();
+  testSharedPool();
+  testPinWait();
+  testBackgroundWriter();
+  testPoolStats();
+  return 0;
+}
+
+// ************************************************************
+void
+testChecksumFailure (void)
+{
+  BM_BufferPool bm;
+  BM_PageHandle h;
+
+  testName = "test pinning pages corrupted on disk";
+
+  fillPages(TEST_FILE, 4);
+  // flip bytes in the middle of page 1 and zero the tail of page 2, the way
+  // a torn write leaves it; data page p starts at (p + 1) * PAGE_SIZE
+  overwriteFile(TEST_FILE, 2 * PAGE_SIZE + 100, 'X', 10);
+  overwriteFile(TEST_FILE, 4 * PAGE_SIZE - 512, 0, 512);
+
+  TEST_CHECK(initBufferPool(&bm, TEST_FILE, 3, RS_FIFO, NULL));
+  TEST_CHECK(pinPage(&bm, &h, 0));
+  CHECK_TRUE(strcmp(h.data, "Page-0") == 0, "intact page reads back");
+  TEST_CHECK(unpinPage(&bm, &h));
+  CHECK_EQUALS_INT(RC_CHECKSUM_FAILED, pinPage(&bm, &h, 1), "page with flipped bytes is rejected");
+  CHECK_EQUALS_INT(RC_CHECKSUM_FAILED, pinPage(&bm, &h, 2), "page with a zeroed tail is rejected");
+  TEST_CHECK(pinPage(&bm, &h, 3));
+  CHECK_TRUE(strcmp(h.data, "Page-3") == 0, "page after the corrupted ones reads back");
+  TEST_CHECK(unpinPage(&bm, &h));
+  // pages the file was grown by but that were never written are all zeros
+  TEST_CHECK(pinPage(&bm, &h, 5));
+  CHECK_TRUE(h.data[0] == 0, "page never written reads as zeros");
+  TEST_CHECK(unpinPage(&bm, &h));
+  TEST_CHECK(shutdownBufferPool(&bm));
+  TEST_CHECK(destroyPageFile(TEST_FILE));
+
+  TEST_DONE();
+}
+
+// ************************************************************
+void
+testResize (void)
+{
+  BM_BufferPool bm;
+  BM_PageHandle pinned[3];
+  char *pinnedData[3];
+  int i, reads, writes;
+
+  testName = "test resizing a buffer pool";
+
+  fillPages(TEST_FILE, 10);
+  TEST_CHECK(initBufferPool(&bm, TEST_FILE, 4, RS_LRU, NULL));
+
+  // once grown, the pool holds every page and a second pass reads nothing
+  TEST_CHECK(resizeBufferPool(&bm, 12));
+  CHECK_EQUALS_INT(12, bm.numPages, "pool grows");
+  for (i = 0; i < 10; i++)
+    checkPage(&bm, i, "Page-%i");
+  reads = getNumReadIO(&bm);
+  for (i = 0; i < 10; i++)
+    checkPage(&bm, i, "Page-%i");
+  CHECK_EQUALS_INT(reads, getNumReadIO(&bm), "grown pool keeps every page");
+
+  // pages 1 and 3 are dirty and unpinned, 2, 5 and 8 pinned and 2 dirty too
+  writePage(&bm, 1, "Dirty-%i");
+  writePage(&bm, 3, "Dirty-%i");
+  for (i = 0; i < 3; i++)
+    {
+      TEST_CHECK(pinPage(&bm, &pinned[i], 2 + 3 * i));
+      pinnedData[i] = pinned[i].data;
+    }
+  sprintf(pinned[0].data, "Pinned-%i", 2);
+  TEST_CHECK(markDirty(&bm, &pinned[0]));
+
+  writes = getNumWriteIO(&bm);
+  CHECK_EQUALS_INT(RC_BUFFERPOOL_IN_USE, resizeBufferPool(&bm, 2), "pool cannot shrink below its pinned pages");
+  CHECK_EQUALS_INT(12, bm.numPages, "failed shrink leaves the pool as it was");
+  TEST_CHECK(resizeBufferPool(&bm, 3));
+  CHECK_EQUALS_INT(3, bm.numPages, "pool shrinks to its pinned pages");
+  for (i = 0; i < 3; i++)
+    {
+      CHECK_TRUE(holdsPage(&bm, 2 + 3 * i), "pinned page stays in the pool");
+      CHECK_TRUE(pinned[i].data == pinnedData[i], "pinned page stays in its frame");
+    }
+  CHECK_TRUE(strcmp(pinned[0].data, "Pinned-2") == 0, "pinned dirty page keeps its contents");
+  CHECK_TRUE(getNumWriteIO(&bm) >= writes + 2, "evicted dirty pages are written");
+  for (i = 0; i < 3; i++)
+    TEST_CHECK(unpinPage(&bm, &pinned[i]));
+
+  // grow again and read everything back, through the pool and from disk
+  TEST_CHECK(resizeBufferPool(&bm, 8));
+  CHECK_EQUALS_INT(8, bm.numPages, "shrunk pool grows again");
+  checkPage(&bm, 1, "Dirty-%i");
+  checkPage(&bm, 2, "Pinned-%i");
+  checkPage(&bm, 3, "Dirty-%i");
+  checkPage(&bm, 9, "Page-%i");
+  TEST_CHECK(shutdownBufferPool(&bm));
+  TEST_CHECK(initBufferPool(&bm, TEST_FILE, 3, RS_FIFO, NULL));
+  for (i = 0; i < 10; i++)
+    checkPage(&bm, i, i == 1 || i == 3 ? "Dirty-%i" : i == 2 ? "Pinned-%i" : "Page-%i");
+  TEST_CHECK(shutdownBufferPool(&bm));
+  TEST_CHECK(destroyPageFile(TEST_FILE));
+
+  TEST_DONE();
+}
+
+// ************************************************************
+void
+testSharedPool (void)
+{
+  BM_BufferPool a, b;
+  BM_PageHandle ha, hb;
+  int round, i;
+
+  testName = "test two page files in one shared buffer pool";
+
+  TEST_CHECK(createPageFile(TEST_FILE));
+  TEST_CHECK(createPageFile(OTHER_TEST_FILE));
+  TEST_CHECK(initSharedBufferPool(4, RS_LRU));
+  TEST_CHECK(attachBufferPool(&a, TEST_FILE));
+  TEST_CHECK(attachBufferPool(&b, OTHER_TEST_FILE));
+  CHECK_TRUE(a.fileId != b.fileId, "each file gets its own file id");
+
+  // both files use the same page numbers; with four frames for twelve pages
+  // frames keep changing hands between the files
+  for (i = 0; i < 6; i++)
+    {
+      writePage(&a, i, "A-%i");
+      writePage(&b, i, "B-%i");
+    }
+  for (round = 0; round < 2; round++)
+    for (i = 0; i < 6; i++)
+      {
+        checkPage(i % 2 ? &a : &b, i, i % 2 ? "A-%i" : "B-%i");
+        checkPage(i % 2 ? &b : &a, i, i % 2 ? "B-%i" : "A-%i");
+      }
+  TEST_CHECK(pinPage(&a, &ha, 0));
+  TEST_CHECK(pinPage(&b, &hb, 0));
+  CHECK_TRUE(ha.data != hb.data, "same page number of two files sits in two frames");
+  CHECK_TRUE(strcmp(ha.data, "A-0") == 0 && strcmp(hb.data, "B-0") == 0, "each file sees its own page");
+  TEST_CHECK(unpinPage(&a, &ha));
+  TEST_CHECK(unpinPage(&b, &hb));
+
+  // detaching one file leaves the other's pages in the pool
+  writePage(&b, 2, "B-new-%i");
+  TEST_CHECK(shutdownBufferPool(&a));
+  checkPage(&b, 2, "B-new-%i");
+  CHECK_EQUALS_INT(RC_BUFFERPOOL_IN_USE, shutdownSharedBufferPool(), "pool stays while a file is attached");
+  TEST_CHECK(shutdownBufferPool(&b));
+  TEST_CHECK(shutdownSharedBufferPool());
+  CHECK_TRUE(!isSharedBufferPoolActive(), "pool is gone once shut down");
+
+  // each file's pages reached that file only
+  TEST_CHECK(initBufferPool(&a, TEST_FILE, 3, RS_FIFO, NULL));
+  TEST_CHECK(initBufferPool(&b, OTHER_TEST_FILE, 3, RS_FIFO, NULL));
+  for (i = 0; i < 6; i++)
+    {
+      checkPage(&a, i, "A-%i");
+      checkPage(&b, i, i == 2 ? "B-new-%i" : "B-%i");
+    }
+  TEST_CHECK(shutdownBufferPool(&a));
+  TEST_CHECK(shutdownBufferPool(&b));
+  TEST_CHECK(destroyPageFile(TEST_FILE));
+  TEST_CHECK(destroyPageFile(OTHER_TEST_FILE));
+
+  TEST_DONE();
+}
+
+// ************************************************************
+void
+testPinWait (void)
+{
+  BM_BufferPool bm;
+  BM_PageHandle pinned[2], h;
+  PinWaiter waiter;
+  pthread_t thread;
+
+  testName = "test pins that wait for a frame";
+
+  fillPages(TEST_FILE, 4);
+  TEST_CHECK(initBufferPool(&bm, TEST_FILE, 2, RS_FIFO, NULL));
+  TEST_CHECK(pinPage(&bm, &pinned[0], 0));
+  TEST_CHECK(pinPage(&bm, &pinned[1], 1));
+  CHECK_EQUALS_INT(RC_BUFFERPOOL_FULL, pinPage(&bm, &h, 2), "pinPage fails while every frame is pinned");
+
+  // the waiting pin goes through once page 0 is unpinned
+  waiter.bm = &bm;
+  waiter.pageNum = 2;
+  waiter.done = FALSE;
+  CHECK_TRUE(pthread_create(&thread, NULL, pinWaiting, &waiter) == 0, "start the waiting pin");
+  usleep(50000);
+  CHECK_TRUE(!__atomic_load_n(&waiter.done, __ATOMIC_ACQUIRE), "pin waits while every frame is pinned");
+  TEST_CHECK(unpinPage(&bm, &pinned[0]));
+  pthread_join(thread, NULL);
+  TEST_CHECK(waiter.rc);
+  CHECK_TRUE(strcmp(waiter.h.data, "Page-2") == 0, "waiting pin reads its page");
+  CHECK_TRUE(holdsPage(&bm, 1), "pinned page stays in the pool");
+  TEST_CHECK(unpinPage(&bm, &waiter.h));
+  TEST_CHECK(unpinPage(&bm, &pinned[1]));
+  TEST_CHECK(shutdownBufferPool(&bm));
+
+  // a strategy that never evicts fails at once instead of waiting forever
+  TEST_CHECK(initBufferPool(&bm, TEST_FILE, 1, RS_CLOCK, NULL));
+  TEST_CHECK(pinPage(&bm, &h, 0));
+  CHECK_EQUALS_INT(RC_BUFFERPOOL_FULL, pinPageWait(&bm, &h, 1), "pool that cannot evict does not wait");
+  TEST_CHECK(unpinPage(&bm, &h));
+  TEST_CHECK(shutdownBufferPool(&bm));
+  TEST_CHECK(destroyPageFile(TEST_FILE));
+
+  TEST_DONE();
+}
+
+// ************************************************************
+void
+testBackgroundWriter (void)
+{
+  BM_BufferPool bm;
+  BM_PoolStats stats;
+  int i, polls;
+
+  testName = "test the background writer";
+
+  TEST_CHECK(createPageFile(TEST_FILE));
+  TEST_CHECK(initBufferPool(&bm, TEST_FILE, 8, RS_FIFO, NULL));
+  CHECK_EQUALS_INT(RC_ERROR, startBackgroundWriter(&bm, 4, 9), "high watermark above the pool size is rejected");
+  TEST_CHECK(startBackgroundWriter(&bm, 4, 6));
+  TEST_CHECK(getPoolStats(&bm, &stats));
+  CHECK_TRUE(stats.writerRunning, "writer runs once started");
+
+  // dirtying every frame leaves no clean reserve, well below the low
+  // watermark, so the writer cleans frames until the reserve is back
+  for (i = 0; i < 8; i++)
+    writePage(&bm, i, "Written-%i");
+  for (polls = 0; polls < 200; polls++)
+    {
+      TEST_CHECK(getPoolStats(&bm, &stats));
+      if (stats.dirtyFrames <= 8 - 4)
+        break;
+      usleep(10000);
+    }
+  CHECK_TRUE(stats.dirtyFrames <= 8 - 4, "writer cleans frames up to the low watermark");
+  CHECK_TRUE(stats.writerWrites >= 8 - stats.dirtyFrames, "writer wrote the frames it cleaned");
+  CHECK_EQUALS_INT(8, stats.usedFrames, "writer writes frames back without evicting them");
+
+  // evicting the pages it cleaned costs the pins no write
+  TEST_CHECK(stopBackgroundWriter(&bm));
+  TEST_CHECK(getPoolStats(&bm, &stats));
+  CHECK_TRUE(!stats.writerRunning, "writer stops");
+  for (i = 8; i < 8 + 8 - stats.dirtyFrames; i++)
+    checkPage(&bm, i, "");
+  TEST_CHECK(getPoolStats(&bm, &stats));
+  CHECK_EQUALS_INT(0, stats.dirtyEvictions, "pins evict the cleaned frames first");
+  TEST_CHECK(shutdownBufferPool(&bm));
+
+  TEST_CHECK(initBufferPool(&bm, TEST_FILE, 3, RS_FIFO, NULL));
+  for (i = 0; i < 8; i++)
+    checkPage(&bm, i, "Written-%i");
+  TEST_CHECK(shutdownBufferPool(&bm));
+  TEST_CHECK(destroyPageFile(TEST_FILE));
+
+  TEST_DONE();
+}
+
+// ************************************************************
+void
+testPoolStats (void)
+{
+  BM_BufferPool bm;
+  BM_PageHandle h;
+  BM_PoolStats stats;
+  char *message;
+  int i;
+
+  testName = "test the pool statistics";
+
+  fillPages(TEST_FILE, 6);
+  TEST_CHECK(initBufferPool(&bm, TEST_FILE, 3, RS_LRU, NULL));
+  TEST_CHECK(getPoolStats(&bm, &stats));
+  CHECK_EQUALS_INT(RS_LRU, stats.strategy, "stats report the strategy");
+  CHECK_EQUALS_INT(3, stats.totalFrames, "stats report the pool size");
+  CHECK_TRUE(stats.hits == 0 && stats.misses == 0, "fresh pool counts no pins");
+  CHECK_EQUALS_INT(NO_PAGE, stats.nextVictim, "empty pool has no victim");
+
+  // LRU order, coldest first: 0 1 2, then 1 2 0 after the hit on page 0.
+  // Pages 3, 4 and 5 evict 1, 2 and 0 clean, and page 0 evicts the dirty 3
+  for (i = 0; i < 3; i++)
+    checkPage(&bm, i, "Page-%i");
+  checkPage(&bm, 0, "Page-%i");
+  writePage(&bm, 3, "Dirty-%i");
+  checkPage(&bm, 4, "Page-%i");
+  checkPage(&bm, 5, "Page-%i");
+  checkPage(&bm, 0, "Page-%i");
+  TEST_CHECK(getPoolStats(&bm, &stats));
+  CHECK_EQUALS_INT(1, stats.hits, "hits are counted");
+  CHECK_EQUALS_INT(7, stats.misses, "misses are counted");
+  CHECK_EQUALS_INT(3, stats.cleanEvictions, "clean evictions are counted");
+  CHECK_EQUALS_INT(1, stats.dirtyEvictions, "dirty evictions are counted");
+  CHECK_EQUALS_INT(1, stats.lruPromotions, "LRU moves the hit page to the hot end");
+  CHECK_EQUALS_INT(7, stats.numReadIO, "every miss reads its page");
+  CHECK_EQUALS_INT(1, stats.numWriteIO, "the dirty victim is written");
+  CHECK_EQUALS_INT(4, stats.nextVictim, "coldest page is the next victim");
+  CHECK_TRUE(stats.usedFrames == 3 && stats.pinnedFrames == 0 && stats.dirtyFrames == 0, "frame occupancy is counted");
+
+  message = sprintPoolStats(&bm);
+  CHECK_TRUE(message != NULL, "stats print");
+  CHECK_TRUE(strstr(message, "hits 1 misses 7 ") != NULL, "printed stats show the pins");
+  CHECK_TRUE(strstr(message, "evictions clean 3 dirty 1\n") != NULL, "printed stats show the evictions");
+  CHECK_TRUE(strstr(message, "of 3\n") != NULL, "printed stats show the pool size");
+  CHECK_TRUE(strstr(message, "strategy LRU next victim 4 ") != NULL, "printed stats show the strategy internals");
+  free(message);
+  TEST_CHECK(shutdownBufferPool(&bm));
+
+  // a strategy that cannot evict reports no victim and fails pins instead
+  TEST_CHECK(initBufferPool(&bm, TEST_FILE, 2, RS_CLOCK, NULL));
+  checkPage(&bm, 0, "Page-%i");
+  checkPage(&bm, 1, "Page-%i");
+  CHECK_EQUALS_INT(RC_BUFFERPOOL_FULL, pinPage(&bm, &h, 2), "CLOCK pool does not evict");
+  TEST_CHECK(getPoolStats(&bm, &stats));
+  CHECK_EQUALS_INT(RS_CLOCK, stats.strategy, "stats report the CLOCK strategy");
+  CHECK_EQUALS_INT(NO_PAGE, stats.nextVictim, "CLOCK pool has no victim");
+  CHECK_EQUALS_INT(2, stats.misses, "failed pin is no miss");
+  CHECK_TRUE(stats.cleanEvictions == 0 && stats.dirtyEvictions == 0, "CLOCK pool evicts nothing");
+  TEST_CHECK(shutdownBufferPool(&bm));
+  TEST_CHECK(destroyPageFile(TEST_FILE));
+
+  TEST_DONE();
+}
+
+// ************************************************************
+// writes "Page-<n>" to the first numPages pages of a new page file and
+// grows it by a few more pages that stay unwritten
+void
+fillPages (const char *fileName, int numPages)
+{
+  BM_BufferPool bm;
+  BM_PageHandle h;
+  SM_FileHandle fh;
+  int i;
+
+  TEST_CHECK(createPageFile((char *) fileName));
+  TEST_CHECK(initBufferPool(&bm, fileName, 3, RS_FIFO, NULL));
+  for (i = 0; i < numPages; i++)
+    {
+      TEST_CHECK(pinPage(&bm, &h, i));
+      sprintf(h.data, "Page-%i", i);
+      TEST_CHECK(markDirty(&bm, &h));
+      TEST_CHECK(unpinPage(&bm, &h));
+    }
+  TEST_CHECK(shutdownBufferPool(&bm));
+  TEST_CHECK(openPageFile((char *) fileName, &fh));
+  TEST_CHECK(ensureCapacity(numPages + 4, &fh));
+  TEST_CHECK(closePageFile(&fh));
+}
+
+// overwrites length bytes of the file at offset, behind the storage manager
+void
+overwriteFile (const char *fileName, off_t offset, char value, int length)
+{
+  char bytes[PAGE_SIZE];
+  int fd = open(fileName, O_WRONLY);
+
+  memset(bytes, value, length);
+  CHECK_TRUE(fd != -1 && pwrite(fd, bytes, length, offset) == length, "overwrite the page file");
+  close(fd);
+}
+
+// whether one of the pool's frames holds pageNum
+bool
+holdsPage (BM_BufferPool *bm, PageNumber pageNum)
+{
+  PageNumber *contents = getFrameContents(bm);
+  int i;
+
+  for (i = 0; contents != NULL && i < bm->numPages; i++)
+    if (contents[i] == pageNum)
+      return TRUE;
+  return FALSE;
+}
+
+// stores format filled in with pageNum on the page and marks it dirty
+void
+writePage (BM_BufferPool *bm, PageNumber pageNum, const char *format)
+{
+  BM_PageHandle h;
+
+  TEST_CHECK(pinPage(bm, &h, pageNum));
+  sprintf(h.data, format, pageNum);
+  TEST_CHECK(markDirty(bm, &h));
+  TEST_CHECK(unpinPage(bm, &h));
+}
+
+// checks that the page holds format filled in with pageNum
+void
+checkPage (BM_BufferPool *bm, PageNumber pageNum, const char *format)
+{
+  BM_PageHandle h;
+  char expected[PAGE_SIZE];
+
+  sprintf(expected, format, pageNum);
+  TEST_CHECK(pinPage(bm, &h, pageNum));
+  CHECK_TRUE(strcmp(h.data, expected) == 0, "page holds what was last written");
+  TEST_CHECK(unpinPage(bm, &h));
+}
+
+// thread body of a PinWaiter
+void *
+pinWaiting (void *arg)
+{
+  PinWaiter *waiter = arg;
+
+  waiter->rc = pinPageWait(waiter->bm, &waiter->h, waiter->pageNum);
+  __atomic_store_n(&waiter->done, TRUE, __ATOMIC_RELEASE);
+  return NULL;
+}
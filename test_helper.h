@@ -77,6 +77,30 @@ extern char *testName;
 			printf("[%s-%s-L%i-%s] OK: expected an error and was RC <%i>: %s\n",TEST_INFO,  result , message); \
 		} while(0)
 
+// like ASSERT_TRUE and ASSERT_EQUALS_INT, but stop the test program when
+// the check does not hold
+#define CHECK_TRUE(real,message)					\
+		do {									\
+			if (!(real))							\
+			{									\
+				printf("[%s-%s-L%i-%s] FAILED: expected true: %s\n",TEST_INFO, message); \
+				exit(1);							\
+			}									\
+			printf("[%s-%s-L%i-%s] OK: expected true: %s\n",TEST_INFO, message); \
+		} while(0)
+
+#define CHECK_EQUALS_INT(expected,real,message)			\
+		do {									\
+			int expected_internal = (expected);				\
+			int real_internal = (real);					\
+			if (expected_internal != real_internal)			\
+			{									\
+				printf("[%s-%s-L%i-%s] FAILED: expected <%i> but was <%i>: %s\n",TEST_INFO, expected_internal, real_internal, message); \
+				exit(1);							\
+			}									\
+			printf("[%s-%s-L%i-%s] OK: expected <%i> and was <%i>: %s\n",TEST_INFO, expected_internal, real_internal, message); \
+		} while(0)
+
 // test worked
 #define TEST_DONE()							\
 		do {									\
@@ -0,0 +1,1084 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "dberror.h"
+#include "expr.h"
+#include "tables.h"
+#include "storage_mgr.h"
+#include "buffer_mgr.h"
+#include "record_mgr.h"
+#include "test_helper.h"
+
+#define TEST_TABLE "test_table_r"
+#define TEST_PAX_TABLE "test_table_p"
+#define NAME_LENGTH 200
+// records the layout comparison inserts, some of them after deletes
+#define LAYOUT_RECORDS 140
+#define BULK_RECORDS 600
+// short records the churn test keeps live and its delete/insert rounds
+#define CHURN_RECORDS 600
+#define CHURN_LENGTH 8
+#define CHURN_ROUNDS 100
+#define PARALLEL_RECORDS 1200
+#define PARALLEL_LENGTH 150
+
+// what the parallel scan callback collects; the calling thread holds its
+// first record until another worker has called back as well
+typedef struct ParallelResult {
+  pthread_mutex_t lock;
+  pthread_cond_t otherWorker;
+  pthread_t caller;
+  bool held;
+  bool sawOtherWorker;
+  bool seen[PARALLEL_RECORDS];
+  int count;
+  int duplicates;
+} ParallelResult;
+
+// test methods
+static void testInsertAndRead (void);
+static void testGrowingUpdate (void);
+static void testDeleteAndSlotReuse (void);
+static void testCompaction (void);
+static void testReopen (void);
+static void testFullScan (void);
+static void testPaxLayout (void);
+static void testBatchSelection (void);
+static void testProjectedScan (void);
+static void testRecordRefs (void);
+static void testBulkInsert (void);
+static void testShortRecordChurn (void);
+static void testParallelScan (void);
+static void testTableOptions (void);
+
+// helper methods
+static Schema *testSchema (void);
+static void setTestRecord (Record *r, Schema *schema, int key, int length);
+static bool isTestRecord (Record *r, Schema *schema, int key, int length);
+static void insertTestRecord (RM_TableData *table, int key, int length, RID *id);
+static void applyLayoutWorkload (RM_TableData *table, RID *ids);
+static void compareLayouts (RM_TableData *row, RID *rowIds, RM_TableData *pax, RID *paxIds);
+static int scanKeys (RM_TableData *table, Expr *cond, bool *seen);
+static RC collectParallel (RM_TableData *rel, Record *record, void *arg);
+
+// test name
+char *testName;
+
+// main method
+int
+main (void)
+{
+  testName = "";
+
+  initRecordManager(NULL);
+  testInsertAndRead();
+  testGrowingUpdate();
+  testDeleteAndSlotReuse();
+  testCompaction();
+  testReopen();
+  testFullScan();
+  testPaxLayout();
+  testBatchSelection();
+  testProjectedScan();
+  testRecordRefs();
+  testBulkInsert();
+  testShortRecordChurn();
+  testParallelScan();
+  testTableOptions();
+  shutdownRecordManager();
+  return 0;
+}
+
+// ************************************************************
+void
+testInsertAndRead (void)
+{
+  RM_TableData *table = calloc(1, sizeof(RM_TableData));
+  Schema *schema = testSchema();
+  Record *r;
+  RID ids[100];
+  int i;
+
+  testName = "test inserting and reading records";
+
+  TEST_CHECK(createTable(TEST_TABLE, schema));
+  TEST_CHECK(openTable(table, TEST_TABLE));
+  for (i = 0; i < 100; i++)
+    insertTestRecord(table, i, i % 20, &ids[i]);
+  CHECK_EQUALS_INT(100, getNumTuples(table), "every insert is counted");
+
+  TEST_CHECK(createRecord(&r, schema));
+  for (i = 0; i < 100; i++)
+    {
+      TEST_CHECK(getRecord(table, ids[i], r));
+      CHECK_TRUE(isTestRecord(r, schema, i, i % 20), "record reads back as inserted");
+    }
+  freeRecord(r);
+
+  TEST_CHECK(closeTable(table));
+  TEST_CHECK(deleteTable(TEST_TABLE));
+  free(table);
+  freeSchema(schema);
+
+  TEST_DONE();
+}
+
+// ************************************************************
+void
+testGrowingUpdate (void)
+{
+  RM_TableData *table = calloc(1, sizeof(RM_TableData));
+  Schema *schema = testSchema();
+  Record *r;
+  RecordRef ref;
+  RID ids[60];
+  int i, forwarded = 0;
+
+  testName = "test updates that grow records off their page";
+
+  TEST_CHECK(createTable(TEST_TABLE, schema));
+  TEST_CHECK(openTable(table, TEST_TABLE));
+  // short records all share the first data page
+  for (i = 0; i < 60; i++)
+    insertTestRecord(table, i, 1, &ids[i]);
+
+  // growing every record to the full string length overflows that page, so
+  // later records have to move their bodies behind a forwarding stub
+  TEST_CHECK(createRecord(&r, schema));
+  for (i = 0; i < 60; i++)
+    {
+      setTestRecord(r, schema, i, NAME_LENGTH);
+      r->id = ids[i];
+      TEST_CHECK(updateRecord(table, r));
+    }
+  for (i = 0; i < 60; i++)
+    {
+      TEST_CHECK(getRecordRef(table, ids[i], &ref));
+      if (ref.page.pageNum != ids[i].page)
+        forwarded++;
+      TEST_CHECK(releaseRecordRef(&ref));
+    }
+  CHECK_TRUE(forwarded > 0, "some grown records were forwarded to another page");
+
+  // update the forwarded records once more, then read all of them back
+  for (i = 0; i < 60; i++)
+    {
+      setTestRecord(r, schema, i + 1, NAME_LENGTH - 1);
+      r->id = ids[i];
+      TEST_CHECK(updateRecord(table, r));
+    }
+  for (i = 0; i < 60; i++)
+    {
+      TEST_CHECK(getRecord(table, ids[i], r));
+      CHECK_TRUE(isTestRecord(r, schema, i + 1, NAME_LENGTH - 1), "record reads back as last updated");
+    }
+  CHECK_EQUALS_INT(60, getNumTuples(table), "updates do not change the record count");
+  freeRecord(r);
+
+  TEST_CHECK(closeTable(table));
+  TEST_CHECK(deleteTable(TEST_TABLE));
+  free(table);
+  freeSchema(schema);
+
+  TEST_DONE();
+}
+
+// ************************************************************
+void
+testDeleteAndSlotReuse (void)
+{
+  RM_TableData *table = calloc(1, sizeof(RM_TableData));
+  Schema *schema = testSchema();
+  Record *r;
+  RID ids[10];
+  RID reused;
+  int i;
+
+  testName = "test deleting records and reusing their slots";
+
+  TEST_CHECK(createTable(TEST_TABLE, schema));
+  TEST_CHECK(openTable(table, TEST_TABLE));
+  for (i = 0; i < 10; i++)
+    insertTestRecord(table, i, 10, &ids[i]);
+
+  TEST_CHECK(deleteRecord(table, ids[3]));
+  CHECK_EQUALS_INT(9, getNumTuples(table), "delete is counted");
+  TEST_CHECK(createRecord(&r, schema));
+  CHECK_EQUALS_INT(RC_RECORD_NOT_FOUND, getRecord(table, ids[3], r), "deleted record is gone");
+  CHECK_EQUALS_INT(RC_RECORD_NOT_FOUND, deleteRecord(table, ids[3]), "deleted record cannot be deleted again");
+
+  insertTestRecord(table, 100, 10, &reused);
+  CHECK_EQUALS_INT(ids[3].page, reused.page, "insert reuses the page of the deleted record");
+  CHECK_EQUALS_INT(ids[3].slot, reused.slot, "insert reuses the slot of the deleted record");
+  TEST_CHECK(getRecord(table, reused, r));
+  CHECK_TRUE(isTestRecord(r, schema, 100, 10), "record in the reused slot reads back");
+  TEST_CHECK(getRecord(table, ids[4], r));
+  CHECK_TRUE(isTestRecord(r, schema, 4, 10), "neighbouring record is untouched");
+  CHECK_EQUALS_INT(10, getNumTuples(table), "insert into a reused slot is counted");
+  freeRecord(r);
+
+  TEST_CHECK(closeTable(table));
+  TEST_CHECK(deleteTable(TEST_TABLE));
+  free(table);
+  freeSchema(schema);
+
+  TEST_DONE();
+}
+
+// ************************************************************
+void
+testCompaction (void)
+{
+  RM_TableData *table = calloc(1, sizeof(RM_TableData));
+  Schema *schema = testSchema();
+  Record *r;
+  RID ids[100];
+  RID id;
+  int i, onFirstPage = 0;
+
+  testName = "test reusing space scattered over a page";
+
+  TEST_CHECK(createTable(TEST_TABLE, schema));
+  TEST_CHECK(openTable(table, TEST_TABLE));
+  // fill the first data page with full-length records
+  for (i = 0; i < 100; i++)
+    {
+      insertTestRecord(table, i, NAME_LENGTH, &ids[i]);
+      if (ids[i].page != ids[0].page)
+        break;
+      onFirstPage++;
+    }
+  CHECK_TRUE(onFirstPage > 2 && onFirstPage < 100, "records fill the first page");
+
+  // every other body leaves a hole between the remaining ones; the new
+  // records only fit into the page once it is compacted
+  for (i = 1; i < onFirstPage; i += 2)
+    TEST_CHECK(deleteRecord(table, ids[i]));
+  for (i = 1; i < onFirstPage; i += 2)
+    {
+      insertTestRecord(table, 1000 + i, NAME_LENGTH, &id);
+      CHECK_EQUALS_INT(ids[0].page, id.page, "freed space on the page is reused");
+      ids[i] = id;
+    }
+
+  // read the page back from disk so every body has to lie within it
+  TEST_CHECK(closeTable(table));
+  TEST_CHECK(openTable(table, TEST_TABLE));
+  TEST_CHECK(createRecord(&r, schema));
+  for (i = 0; i < onFirstPage; i++)
+    {
+      TEST_CHECK(getRecord(table, ids[i], r));
+      CHECK_TRUE(isTestRecord(r, schema, i % 2 ? 1000 + i : i, NAME_LENGTH), "record survives compaction");
+    }
+  freeRecord(r);
+
+  TEST_CHECK(closeTable(table));
+  TEST_CHECK(deleteTable(TEST_TABLE));
+  free(table);
+  freeSchema(schema);
+
+  TEST_DONE();
+}
+
+// ************************************************************
+void
+testReopen (void)
+{
+  RM_TableData *table = calloc(1, sizeof(RM_TableData));
+  Schema *schema = testSchema();
+  BM_BufferPool bm;
+  BM_PageHandle h;
+  Record *r;
+  RID ids[200];
+  int i;
+
+  testName = "test reopening a table";
+
+  TEST_CHECK(createTable(TEST_TABLE, schema));
+  TEST_CHECK(openTable(table, TEST_TABLE));
+  for (i = 0; i < 200; i++)
+    insertTestRecord(table, i, i % NAME_LENGTH, &ids[i]);
+  for (i = 0; i < 200; i += 4)
+    TEST_CHECK(deleteRecord(table, ids[i]));
+  TEST_CHECK(closeTable(table));
+  freeSchema(schema);
+
+  TEST_CHECK(openTable(table, TEST_TABLE));
+  schema = table->schema;
+  CHECK_EQUALS_INT(2, schema->numAttr, "schema is read back");
+  CHECK_EQUALS_INT(NAME_LENGTH, schema->typeLength[1], "string length is read back");
+  CHECK_EQUALS_INT(150, getNumTuples(table), "record count is read back");
+  TEST_CHECK(createRecord(&r, schema));
+  for (i = 0; i < 200; i++)
+    {
+      if (i % 4 == 0)
+        CHECK_EQUALS_INT(RC_RECORD_NOT_FOUND, getRecord(table, ids[i], r), "deleted record stays deleted");
+      else
+        {
+          TEST_CHECK(getRecord(table, ids[i], r));
+          CHECK_TRUE(isTestRecord(r, schema, i, i % NAME_LENGTH), "record reads back after reopening");
+        }
+    }
+  freeRecord(r);
+  // closeTable frees the schema openTable read
+  TEST_CHECK(closeTable(table));
+
+  // a header written by another format version is rejected
+  TEST_CHECK(initBufferPool(&bm, TEST_TABLE, 3, RS_FIFO, NULL));
+  TEST_CHECK(pinPage(&bm, &h, 0));
+  ((int *) h.data)[1]++;
+  TEST_CHECK(markDirty(&bm, &h));
+  TEST_CHECK(unpinPage(&bm, &h));
+  TEST_CHECK(shutdownBufferPool(&bm));
+  CHECK_EQUALS_INT(RC_TABLE_FORMAT_UNSUPPORTED, openTable(table, TEST_TABLE), "unknown format version is rejected");
+
+  TEST_CHECK(deleteTable(TEST_TABLE));
+  free(table);
+
+  TEST_DONE();
+}
+
+// ************************************************************
+void
+testFullScan (void)
+{
+  RM_TableData *table = calloc(1, sizeof(RM_TableData));
+  Schema *schema = testSchema();
+  RM_ScanHandle sc;
+  Record *r;
+  Value *v;
+  Expr *sel, *left, *right;
+  RID ids[300];
+  int lengths[300];
+  bool seen[300];
+  int i, key, live = 0, matches = 0, expectedMatches = 0;
+  RC rc;
+
+  testName = "test scanning a table";
+
+  TEST_CHECK(createTable(TEST_TABLE, schema));
+  TEST_CHECK(openTable(table, TEST_TABLE));
+  for (i = 0; i < 300; i++)
+    {
+      lengths[i] = i % 10;
+      insertTestRecord(table, i, lengths[i], &ids[i]);
+    }
+  // deleted records must not show up, forwarded ones exactly once
+  TEST_CHECK(createRecord(&r, schema));
+  for (i = 0; i < 300; i++)
+    {
+      if (i % 5 == 0)
+        {
+          TEST_CHECK(deleteRecord(table, ids[i]));
+        }
+      else if (i % 3 == 0)
+        {
+          lengths[i] = NAME_LENGTH;
+          setTestRecord(r, schema, i, lengths[i]);
+          r->id = ids[i];
+          TEST_CHECK(updateRecord(table, r));
+        }
+    }
+
+  memset(seen, 0, sizeof(seen));
+  TEST_CHECK(startScan(table, &sc, NULL));
+  while ((rc = next(&sc, r)) == RC_OK)
+    {
+      TEST_CHECK(getAttr(r, schema, 0, &v));
+      key = v->v.intV;
+      freeVal(v);
+      CHECK_TRUE(key >= 0 && key < 300 && key % 5 != 0 && !seen[key], "scan returns each live record once");
+      CHECK_TRUE(r->id.page == ids[key].page && r->id.slot == ids[key].slot, "scan returns the record's id");
+      CHECK_TRUE(isTestRecord(r, schema, key, lengths[key]), "scanned record has its latest contents");
+      seen[key] = TRUE;
+      live++;
+    }
+  CHECK_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "scan ends after the last record");
+  TEST_CHECK(closeScan(&sc));
+  CHECK_EQUALS_INT(240, live, "scan returns every live record");
+
+  // a = key < 100
+  MAKE_ATTRREF(left, 0);
+  MAKE_CONS(right, stringToValue("i100"));
+  MAKE_BINOP_EXPR(sel, left, right, OP_COMP_SMALLER);
+  for (i = 0; i < 100; i++)
+    if (i % 5 != 0)
+      expectedMatches++;
+  TEST_CHECK(startScan(table, &sc, sel));
+  while (next(&sc, r) == RC_OK)
+    matches++;
+  TEST_CHECK(closeScan(&sc));
+  CHECK_EQUALS_INT(expectedMatches, matches, "scan returns only records satisfying the condition");
+  freeExpr(sel);
+  freeRecord(r);
+
+  TEST_CHECK(closeTable(table));
+  TEST_CHECK(deleteTable(TEST_TABLE));
+  free(table);
+  freeSchema(schema);
+
+  TEST_DONE();
+}
+
+// ************************************************************
+void
+testPaxLayout (void)
+{
+  RM_TableData *row = calloc(1, sizeof(RM_TableData));
+  RM_TableData *pax = calloc(1, sizeof(RM_TableData));
+  Schema *schema = testSchema();
+  RID rowIds[LAYOUT_RECORDS];
+  RID paxIds[LAYOUT_RECORDS];
+
+  testName = "test PAX tables against the row layout";
+
+  TEST_CHECK(createTable(TEST_TABLE, schema));
+  TEST_CHECK(createTableWithLayout(TEST_PAX_TABLE, schema, RM_LAYOUT_PAX));
+  TEST_CHECK(openTable(row, TEST_TABLE));
+  TEST_CHECK(openTable(pax, TEST_PAX_TABLE));
+  applyLayoutWorkload(row, rowIds);
+  applyLayoutWorkload(pax, paxIds);
+  compareLayouts(row, rowIds, pax, paxIds);
+
+  TEST_CHECK(closeTable(row));
+  TEST_CHECK(closeTable(pax));
+  TEST_CHECK(openTable(row, TEST_TABLE));
+  TEST_CHECK(openTable(pax, TEST_PAX_TABLE));
+  compareLayouts(row, rowIds, pax, paxIds);
+
+  TEST_CHECK(closeTable(row));
+  TEST_CHECK(closeTable(pax));
+  TEST_CHECK(deleteTable(TEST_TABLE));
+  TEST_CHECK(deleteTable(TEST_PAX_TABLE));
+  free(row);
+  free(pax);
+  freeSchema(schema);
+
+  TEST_DONE();
+}
+
+// ************************************************************
+void
+testBatchSelection (void)
+{
+  RM_TableData *table = calloc(1, sizeof(RM_TableData));
+  Schema *schema = testSchema();
+  RM_ScanHandle sc;
+  RecordBatch *batch;
+  Record *r;
+  Expr *sel, *left, *right;
+  RID id;
+  int i, k, key, rows = 0, selected = 0;
+
+  testName = "test selection vectors of record batches";
+
+  TEST_CHECK(createTable(TEST_TABLE, schema));
+  TEST_CHECK(openTable(table, TEST_TABLE));
+  for (i = 0; i < 200; i++)
+    insertTestRecord(table, i, i % 30, &id);
+
+  // a < 73
+  MAKE_ATTRREF(left, 0);
+  MAKE_CONS(right, stringToValue("i73"));
+  MAKE_BINOP_EXPR(sel, left, right, OP_COMP_SMALLER);
+  TEST_CHECK(createRecordBatch(&batch, schema, 32));
+  TEST_CHECK(createRecord(&r, schema));
+  TEST_CHECK(startScan(table, &sc, sel));
+  while (nextBatch(&sc, batch, 32) == RC_OK)
+    {
+      CHECK_TRUE(batch->numRows > 0 && batch->numRows <= 32, "batch holds at most the rows asked for");
+      // the selection lists exactly the rows satisfying the condition, in order
+      for (i = 0, k = 0; i < batch->numRows; i++)
+        {
+          key = *(int *) (batch->data + i * batch->recSize);
+          if (k < batch->numSelected && batch->selection[k] == i)
+            {
+              CHECK_TRUE(key < 73, "selected row satisfies the condition");
+              k++;
+            }
+          else
+            CHECK_TRUE(key >= 73, "row left out of the selection fails the condition");
+          TEST_CHECK(getRecord(table, batch->ids[i], r));
+          CHECK_TRUE(memcmp(r->data, batch->data + i * batch->recSize, batch->recSize) == 0,
+              "batch row matches the record with its id");
+        }
+      CHECK_EQUALS_INT(batch->numSelected, k, "selection holds only rows of the batch");
+      rows += batch->numRows;
+      selected += batch->numSelected;
+    }
+  TEST_CHECK(closeScan(&sc));
+  CHECK_EQUALS_INT(200, rows, "batches cover every record");
+  CHECK_EQUALS_INT(73, selected, "batches select every matching record");
+  freeRecord(r);
+  freeRecordBatch(batch);
+  freeExpr(sel);
+
+  TEST_CHECK(closeTable(table));
+  TEST_CHECK(deleteTable(TEST_TABLE));
+  free(table);
+  freeSchema(schema);
+
+  TEST_DONE();
+}
+
+// ************************************************************
+void
+testProjectedScan (void)
+{
+  RM_TableData *table = calloc(1, sizeof(RM_TableData));
+  Schema *schema = testSchema();
+  Schema *projection;
+  RM_ScanHandle sc;
+  Record *full, *projected;
+  Expr *sel, *left, *right;
+  Value *key, *expected, *name;
+  RID id;
+  int attrs[] = { 1 };
+  int i, count = 0;
+  RC rc;
+
+  testName = "test scans returning projected attributes";
+
+  TEST_CHECK(createTable(TEST_TABLE, schema));
+  TEST_CHECK(openTable(table, TEST_TABLE));
+  for (i = 0; i < 200; i++)
+    insertTestRecord(table, i, i % 30 + 1, &id);
+
+  // only b is returned while the condition reads a
+  projection = createProjectionSchema(schema, 1, attrs);
+  CHECK_TRUE(projection != NULL && projection->numAttr == 1, "projection schema has the listed attribute");
+  CHECK_TRUE(getRecordSize(projection) < getRecordSize(schema), "projected records leave out the other attributes");
+  MAKE_ATTRREF(left, 0);
+  MAKE_CONS(right, stringToValue("i50"));
+  MAKE_BINOP_EXPR(sel, left, right, OP_COMP_SMALLER);
+  TEST_CHECK(createRecord(&full, schema));
+  TEST_CHECK(createRecord(&projected, projection));
+  TEST_CHECK(startProjectedScan(table, &sc, sel, 1, attrs));
+  while ((rc = next(&sc, projected)) == RC_OK)
+    {
+      TEST_CHECK(getRecord(table, projected->id, full));
+      TEST_CHECK(getAttr(full, schema, 0, &key));
+      TEST_CHECK(getAttr(full, schema, 1, &expected));
+      TEST_CHECK(getAttr(projected, projection, 0, &name));
+      CHECK_TRUE(key->v.intV < 50, "projected scan applies the condition");
+      CHECK_TRUE(strcmp(expected->v.stringV, name->v.stringV) == 0, "projected value is the record's b");
+      freeVal(key);
+      freeVal(expected);
+      freeVal(name);
+      count++;
+    }
+  CHECK_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "projected scan ends after the last record");
+  TEST_CHECK(closeScan(&sc));
+  CHECK_EQUALS_INT(50, count, "projected scan returns every matching record");
+  freeRecord(full);
+  freeRecord(projected);
+  freeSchema(projection);
+  freeExpr(sel);
+
+  TEST_CHECK(closeTable(table));
+  TEST_CHECK(deleteTable(TEST_TABLE));
+  free(table);
+  freeSchema(schema);
+
+  TEST_DONE();
+}
+
+// ************************************************************
+void
+testRecordRefs (void)
+{
+  RM_TableData *table = calloc(1, sizeof(RM_TableData));
+  Schema *schema = testSchema();
+  BM_BufferPool *bm;
+  RecordRef ref;
+  Record *r;
+  Value *copied, *inPlace;
+  RID ids[60];
+  int layout, i, attr, pinned, *fixCounts;
+
+  testName = "test reading records in place";
+
+  for (layout = RM_LAYOUT_ROW; layout <= RM_LAYOUT_PAX; layout++)
+    {
+      TEST_CHECK(createTableWithLayout(TEST_TABLE, schema, layout));
+      TEST_CHECK(openTable(table, TEST_TABLE));
+      for (i = 0; i < 60; i++)
+        insertTestRecord(table, i, 1, &ids[i]);
+      // grown row records are read through their forwarding stubs
+      TEST_CHECK(createRecord(&r, schema));
+      for (i = 0; i < 60; i += 2)
+        {
+          setTestRecord(r, schema, i, NAME_LENGTH);
+          r->id = ids[i];
+          TEST_CHECK(updateRecord(table, r));
+        }
+      for (i = 0; i < 60; i += 10)
+        TEST_CHECK(deleteRecord(table, ids[i]));
+
+      for (i = 0; i < 60; i++)
+        {
+          if (i % 10 == 0)
+            {
+              CHECK_EQUALS_INT(RC_RECORD_NOT_FOUND, getRecordRef(table, ids[i], &ref), "deleted record has no ref");
+              continue;
+            }
+          TEST_CHECK(getRecord(table, ids[i], r));
+          TEST_CHECK(getRecordRef(table, ids[i], &ref));
+          for (attr = 0; attr < schema->numAttr; attr++)
+            {
+              TEST_CHECK(getAttr(r, schema, attr, &copied));
+              TEST_CHECK(getRecordRefAttr(&ref, attr, &inPlace));
+              CHECK_TRUE(copied->dt == inPlace->dt, "ref attribute has the record's type");
+              if (copied->dt == DT_STRING)
+                CHECK_TRUE(strcmp(copied->v.stringV, inPlace->v.stringV) == 0, "ref string equals getRecord's");
+              else
+                CHECK_EQUALS_INT(copied->v.intV, inPlace->v.intV, "ref int equals getRecord's");
+              freeVal(copied);
+              freeVal(inPlace);
+            }
+          TEST_CHECK(releaseRecordRef(&ref));
+          CHECK_EQUALS_INT(RC_RECORD_NOT_FOUND, releaseRecordRef(&ref), "a ref is released only once");
+        }
+      freeRecord(r);
+
+      // every ref let go of its page
+      bm = ((TableManager *) table->mgmtData)->bufferManagerPtr;
+      fixCounts = getFixCounts(bm);
+      for (i = 0, pinned = 0; i < bm->numPages; i++)
+        pinned += fixCounts[i];
+      CHECK_EQUALS_INT(0, pinned, "released refs leave no page pinned");
+
+      TEST_CHECK(closeTable(table));
+      TEST_CHECK(deleteTable(TEST_TABLE));
+    }
+  free(table);
+  freeSchema(schema);
+
+  TEST_DONE();
+}
+
+// ************************************************************
+void
+testBulkInsert (void)
+{
+  RM_TableData *table = calloc(1, sizeof(RM_TableData));
+  Schema *schema = testSchema();
+  RM_ScanHandle sc;
+  Record *records[BULK_RECORDS];
+  Record *r;
+  int layout, i, count;
+
+  testName = "test inserting records in bulk";
+
+  for (i = 0; i < BULK_RECORDS; i++)
+    {
+      TEST_CHECK(createRecord(&records[i], schema));
+      setTestRecord(records[i], schema, i, i % 40);
+    }
+  for (layout = RM_LAYOUT_ROW; layout <= RM_LAYOUT_PAX; layout++)
+    {
+      TEST_CHECK(createTableWithLayout(TEST_TABLE, schema, layout));
+      TEST_CHECK(openTable(table, TEST_TABLE));
+      // the first half fills fresh pages, the second half goes into the slots
+      // deletes freed as well
+      TEST_CHECK(insertRecords(table, records, BULK_RECORDS / 2));
+      for (i = 0; i < BULK_RECORDS / 2; i += 3)
+        TEST_CHECK(deleteRecord(table, records[i]->id));
+      TEST_CHECK(insertRecords(table, records + BULK_RECORDS / 2, BULK_RECORDS / 2));
+      TEST_CHECK(insertRecords(table, records, 0));
+      TEST_CHECK(closeTable(table));
+
+      TEST_CHECK(openTable(table, TEST_TABLE));
+      count = BULK_RECORDS - (BULK_RECORDS / 2 + 2) / 3;
+      CHECK_EQUALS_INT(count, getNumTuples(table), "bulk inserts are counted");
+      TEST_CHECK(createRecord(&r, table->schema));
+      for (i = BULK_RECORDS / 2; i < BULK_RECORDS; i++)
+        {
+          TEST_CHECK(getRecord(table, records[i]->id, r));
+          CHECK_TRUE(isTestRecord(r, table->schema, i, i % 40), "bulk inserted record reads back under its id");
+        }
+      TEST_CHECK(startScan(table, &sc, NULL));
+      for (count = 0; next(&sc, r) == RC_OK; count++)
+        ;
+      TEST_CHECK(closeScan(&sc));
+      CHECK_EQUALS_INT(getNumTuples(table), count, "scan returns every bulk inserted record");
+      freeRecord(r);
+
+      TEST_CHECK(closeTable(table));
+      TEST_CHECK(deleteTable(TEST_TABLE));
+    }
+  for (i = 0; i < BULK_RECORDS; i++)
+    freeRecord(records[i]);
+  free(table);
+  freeSchema(schema);
+
+  TEST_DONE();
+}
+
+// ************************************************************
+void
+testShortRecordChurn (void)
+{
+  RM_TableData *table = calloc(1, sizeof(RM_TableData));
+  Schema *schema = testSchema();
+  TableManager *tableMgr;
+  Record *r;
+  RID ids[CHURN_RECORDS];
+  int lengths[CHURN_RECORDS];
+  int i, round, room, maxPages;
+
+  testName = "test churning short records";
+
+  TEST_CHECK(createTable(TEST_TABLE, schema));
+  TEST_CHECK(openTable(table, TEST_TABLE));
+  for (i = 0; i < CHURN_RECORDS; i++)
+    {
+      lengths[i] = 1 + i % CHURN_LENGTH;
+      insertTestRecord(table, i, lengths[i], &ids[i]);
+    }
+  // each round deletes a few records spread over every page and inserts as
+  // many again, so freed space builds up on pages that are off the free list
+  for (round = 0; round < CHURN_ROUNDS; round++)
+    for (i = round % 50; i < CHURN_RECORDS; i += 50)
+      {
+        TEST_CHECK(deleteRecord(table, ids[i]));
+        lengths[i] = 1 + (i + round) % CHURN_LENGTH;
+        insertTestRecord(table, i, lengths[i], &ids[i]);
+      }
+
+  // a page only leaves the free list once it cannot take the largest record,
+  // so every page but the last holds live records up to that much room
+  tableMgr = table->mgmtData;
+  room = PAGE_DATA_SIZE - sizeof(PageHeader) - tableMgr->maxRecordBytes - sizeof(SlotEntry);
+  maxPages = (CHURN_RECORDS * (sizeof(int) + sizeof(uint16_t) + CHURN_LENGTH + sizeof(SlotEntry)) + room - 1) / room + 1;
+  CHECK_TRUE(tableMgr->lastDataPageNum <= maxPages, "churn reuses freed space instead of appending pages");
+  CHECK_EQUALS_INT(CHURN_RECORDS, getNumTuples(table), "churn keeps the record count");
+  TEST_CHECK(createRecord(&r, schema));
+  for (i = 0; i < CHURN_RECORDS; i++)
+    {
+      TEST_CHECK(getRecord(table, ids[i], r));
+      CHECK_TRUE(isTestRecord(r, schema, i, lengths[i]), "churned record reads back");
+    }
+  freeRecord(r);
+
+  TEST_CHECK(closeTable(table));
+  TEST_CHECK(deleteTable(TEST_TABLE));
+  free(table);
+  freeSchema(schema);
+
+  TEST_DONE();
+}
+
+// ************************************************************
+void
+testParallelScan (void)
+{
+  RM_TableData *table = calloc(1, sizeof(RM_TableData));
+  Schema *schema = testSchema();
+  RM_TableOptions options = { 3, RS_FIFO, 0, RM_WRITE_BACK_ON_EVICT };
+  ParallelResult result;
+  Record *r;
+  RID ids[PARALLEL_RECORDS];
+  int i;
+
+  testName = "test parallel scans on a small buffer pool";
+
+  // records spread over several morsels; growing a quarter of them moves
+  // those behind the last page, so workers contend for the frame kept back
+  // for reading moved bodies
+  TEST_CHECK(createTable(TEST_TABLE, schema));
+  TEST_CHECK(openTableWithOptions(table, TEST_TABLE, &options));
+  for (i = 0; i < PARALLEL_RECORDS; i++)
+    insertTestRecord(table, i, PARALLEL_LENGTH, &ids[i]);
+  TEST_CHECK(createRecord(&r, schema));
+  for (i = 0; i < PARALLEL_RECORDS; i += 4)
+    {
+      setTestRecord(r, schema, i, NAME_LENGTH);
+      r->id = ids[i];
+      TEST_CHECK(updateRecord(table, r));
+    }
+  freeRecord(r);
+
+  memset(&result, 0, sizeof(result));
+  pthread_mutex_init(&result.lock, NULL);
+  pthread_cond_init(&result.otherWorker, NULL);
+  result.caller = pthread_self();
+  TEST_CHECK(startParallelScan(table, NULL, 4, collectParallel, &result));
+  CHECK_TRUE(result.sawOtherWorker, "a three frame pool still scans on more than one thread");
+  CHECK_EQUALS_INT(0, result.duplicates, "no record is handed out twice");
+  CHECK_EQUALS_INT(PARALLEL_RECORDS, result.count, "every record is handed out");
+  pthread_cond_destroy(&result.otherWorker);
+  pthread_mutex_destroy(&result.lock);
+
+  TEST_CHECK(closeTable(table));
+  TEST_CHECK(deleteTable(TEST_TABLE));
+  free(table);
+  freeSchema(schema);
+
+  TEST_DONE();
+}
+
+// ************************************************************
+void
+testTableOptions (void)
+{
+  RM_TableData *table = calloc(1, sizeof(RM_TableData));
+  Schema *schema = testSchema();
+  RM_TableOptions background = { 6, RS_LRU, 2, RM_WRITE_BACK_BACKGROUND };
+  RM_TableOptions onEvict = { 2, RS_FIFO, 0, RM_WRITE_BACK_ON_EVICT };
+  RM_TableOptions tooSmall = { 1, RS_FIFO, 0, RM_WRITE_BACK_ON_EVICT };
+  RM_TableOptions noEviction = { 4, RS_CLOCK, 0, RM_WRITE_BACK_ON_EVICT };
+  RM_TableOptions negativeDepth = { 4, RS_FIFO, -1, RM_WRITE_BACK_ON_EVICT };
+  BM_BufferPool *bm;
+  BM_PoolStats stats;
+  Record *r;
+  RID ids[100];
+  int i;
+
+  testName = "test opening tables with buffer pool options";
+
+  TEST_CHECK(createTable(TEST_TABLE, schema));
+  CHECK_EQUALS_INT(RC_ERROR, openTableWithOptions(table, TEST_TABLE, &tooSmall), "pool of one frame is rejected");
+  CHECK_EQUALS_INT(RC_ERROR, openTableWithOptions(table, TEST_TABLE, &noEviction), "strategy that cannot evict is rejected");
+  CHECK_EQUALS_INT(RC_ERROR, openTableWithOptions(table, TEST_TABLE, &negativeDepth), "negative read-ahead is rejected");
+
+  // a private pool takes every option
+  TEST_CHECK(openTableWithOptions(table, TEST_TABLE, &background));
+  bm = ((TableManager *) table->mgmtData)->bufferManagerPtr;
+  TEST_CHECK(getPoolStats(bm, &stats));
+  CHECK_EQUALS_INT(6, stats.totalFrames, "pool has the requested size");
+  CHECK_EQUALS_INT(RS_LRU, bm->strategy, "pool uses the requested strategy");
+  CHECK_EQUALS_INT(2, stats.readAheadDepth, "pool reads ahead as requested");
+  CHECK_TRUE(stats.writerRunning, "background write-back starts a writer");
+  for (i = 0; i < 50; i++)
+    insertTestRecord(table, i, i % 40, &ids[i]);
+  TEST_CHECK(closeTable(table));
+
+  TEST_CHECK(openTableWithOptions(table, TEST_TABLE, &onEvict));
+  bm = ((TableManager *) table->mgmtData)->bufferManagerPtr;
+  TEST_CHECK(getPoolStats(bm, &stats));
+  CHECK_EQUALS_INT(2, stats.totalFrames, "reopened pool has the new size");
+  CHECK_EQUALS_INT(RS_FIFO, bm->strategy, "reopened pool uses the new strategy");
+  CHECK_EQUALS_INT(0, stats.readAheadDepth, "read-ahead is off");
+  CHECK_TRUE(!stats.writerRunning, "write-back on eviction runs no writer");
+  for (i = 50; i < 100; i++)
+    insertTestRecord(table, i, i % 40, &ids[i]);
+  TEST_CHECK(closeTable(table));
+
+  // a table on the shared pool keeps the pool's size, strategy and writer
+  // and only takes the read-ahead window
+  TEST_CHECK(initSharedBufferPool(4, RS_FIFO));
+  TEST_CHECK(openTableWithOptions(table, TEST_TABLE, &background));
+  bm = ((TableManager *) table->mgmtData)->bufferManagerPtr;
+  TEST_CHECK(getPoolStats(bm, &stats));
+  CHECK_EQUALS_INT(4, stats.totalFrames, "shared pool keeps its size");
+  CHECK_EQUALS_INT(RS_FIFO, bm->strategy, "shared pool keeps its strategy");
+  CHECK_EQUALS_INT(2, stats.readAheadDepth, "table on the shared pool reads ahead as requested");
+  CHECK_TRUE(!stats.writerRunning, "table on the shared pool starts no writer");
+  TEST_CHECK(createRecord(&r, schema));
+  for (i = 0; i < 100; i++)
+    {
+      TEST_CHECK(getRecord(table, ids[i], r));
+      CHECK_TRUE(isTestRecord(r, schema, i, i % 40), "record written through either pool reads back");
+    }
+  freeRecord(r);
+  TEST_CHECK(closeTable(table));
+  TEST_CHECK(shutdownSharedBufferPool());
+
+  TEST_CHECK(deleteTable(TEST_TABLE));
+  free(table);
+  freeSchema(schema);
+
+  TEST_DONE();
+}
+
+// ************************************************************
+// an int key and a string whose stored length varies with its contents
+Schema *
+testSchema (void)
+{
+  char *names[] = { "a", "b" };
+  DataType dt[] = { DT_INT, DT_STRING };
+  int sizes[] = { 0, NAME_LENGTH };
+  int keys[] = { 0 };
+
+  return createSchema(2, names, dt, sizes, 1, keys);
+}
+
+// sets a to key and b to length letters derived from key; setAttr copies
+// the full string length, so the value is padded with zeros
+void
+setTestRecord (Record *r, Schema *schema, int key, int length)
+{
+  char name[NAME_LENGTH + 1];
+  Value v;
+  int i;
+
+  memset(name, 0, sizeof(name));
+  for (i = 0; i < length; i++)
+    name[i] = 'a' + (key + i) % 26;
+  v.dt = DT_INT;
+  v.v.intV = key;
+  TEST_CHECK(setAttr(r, schema, 0, &v));
+  v.dt = DT_STRING;
+  v.v.stringV = name;
+  TEST_CHECK(setAttr(r, schema, 1, &v));
+}
+
+// whether r holds what setTestRecord stores for key and length
+bool
+isTestRecord (Record *r, Schema *schema, int key, int length)
+{
+  Value *a, *b;
+  bool same;
+  int i;
+
+  TEST_CHECK(getAttr(r, schema, 0, &a));
+  TEST_CHECK(getAttr(r, schema, 1, &b));
+  same = a->v.intV == key && (int) strlen(b->v.stringV) == length;
+  for (i = 0; same && i < length; i++)
+    same = b->v.stringV[i] == 'a' + (key + i) % 26;
+  freeVal(a);
+  freeVal(b);
+  return same;
+}
+
+void
+insertTestRecord (RM_TableData *table, int key, int length, RID *id)
+{
+  Record *r;
+
+  TEST_CHECK(createRecord(&r, table->schema));
+  setTestRecord(r, table->schema, key, length);
+  TEST_CHECK(insertRecord(table, r));
+  *id = r->id;
+  freeRecord(r);
+}
+
+// inserts records over several pages, updates a third of them, deletes a
+// quarter and inserts some more into the freed slots
+void
+applyLayoutWorkload (RM_TableData *table, RID *ids)
+{
+  Record *r;
+  int i;
+
+  for (i = 0; i < 120; i++)
+    insertTestRecord(table, i, i % 30, &ids[i]);
+  TEST_CHECK(createRecord(&r, table->schema));
+  for (i = 1; i < 120; i += 3)
+    {
+      setTestRecord(r, table->schema, i, NAME_LENGTH - i % 7);
+      r->id = ids[i];
+      TEST_CHECK(updateRecord(table, r));
+    }
+  freeRecord(r);
+  for (i = 0; i < 120; i += 4)
+    TEST_CHECK(deleteRecord(table, ids[i]));
+  for (i = 120; i < LAYOUT_RECORDS; i++)
+    insertTestRecord(table, i, 5, &ids[i]);
+}
+
+// checks that both tables hold the same records, by id, by full scan and by
+// a scan with a condition
+void
+compareLayouts (RM_TableData *row, RID *rowIds, RM_TableData *pax, RID *paxIds)
+{
+  Record *rowRecord, *paxRecord;
+  Expr *sel, *left, *right;
+  bool rowSeen[LAYOUT_RECORDS], paxSeen[LAYOUT_RECORDS];
+  int i, filtered;
+
+  CHECK_EQUALS_INT(getNumTuples(row), getNumTuples(pax), "both layouts count the same records");
+  TEST_CHECK(createRecord(&rowRecord, row->schema));
+  TEST_CHECK(createRecord(&paxRecord, pax->schema));
+  // ids of deleted records may have been handed out again, so only the live
+  // ones are looked up; the scans below show the deleted ones are gone
+  for (i = 0; i < LAYOUT_RECORDS; i++)
+    {
+      if (i < 120 && i % 4 == 0)
+        continue;
+      TEST_CHECK(getRecord(row, rowIds[i], rowRecord));
+      TEST_CHECK(getRecord(pax, paxIds[i], paxRecord));
+      CHECK_TRUE(memcmp(rowRecord->data, paxRecord->data, getRecordSize(row->schema)) == 0,
+          "both layouts read back the same contents");
+    }
+  freeRecord(rowRecord);
+  freeRecord(paxRecord);
+
+  CHECK_EQUALS_INT(scanKeys(row, NULL, rowSeen), scanKeys(pax, NULL, paxSeen), "full scans return as many records");
+  CHECK_TRUE(memcmp(rowSeen, paxSeen, sizeof(rowSeen)) == 0, "full scans return the same records");
+  for (i = 0; i < LAYOUT_RECORDS; i++)
+    CHECK_TRUE(rowSeen[i] == (i >= 120 || i % 4 != 0), "full scan returns exactly the live records");
+
+  // b < "m" reads only the string attribute
+  MAKE_ATTRREF(left, 1);
+  MAKE_CONS(right, stringToValue("sm"));
+  MAKE_BINOP_EXPR(sel, left, right, OP_COMP_SMALLER);
+  filtered = scanKeys(row, sel, rowSeen);
+  CHECK_TRUE(filtered > 0 && filtered < getNumTuples(row), "condition selects some of the records");
+  CHECK_EQUALS_INT(filtered, scanKeys(pax, sel, paxSeen), "filtered scans return as many records");
+  CHECK_TRUE(memcmp(rowSeen, paxSeen, sizeof(rowSeen)) == 0, "filtered scans return the same records");
+  freeExpr(sel);
+}
+
+// marks the keys of the records a scan returns, returns how many it did
+int
+scanKeys (RM_TableData *table, Expr *cond, bool *seen)
+{
+  RM_ScanHandle sc;
+  Record *r;
+  Value *v;
+  int count = 0;
+
+  memset(seen, 0, LAYOUT_RECORDS * sizeof(bool));
+  TEST_CHECK(createRecord(&r, table->schema));
+  TEST_CHECK(startScan(table, &sc, cond));
+  while (next(&sc, r) == RC_OK)
+    {
+      TEST_CHECK(getAttr(r, table->schema, 0, &v));
+      CHECK_TRUE(v->v.intV >= 0 && v->v.intV < LAYOUT_RECORDS && !seen[v->v.intV], "scan returns each record once");
+      seen[v->v.intV] = TRUE;
+      freeVal(v);
+      count++;
+    }
+  TEST_CHECK(closeScan(&sc));
+  freeRecord(r);
+  return count;
+}
+
+// startParallelScan callback for testParallelScan
+RC
+collectParallel (RM_TableData *rel, Record *record, void *arg)
+{
+  ParallelResult *result = arg;
+  struct timespec deadline;
+  Value *key;
+  bool hold;
+
+  TEST_CHECK(getAttr(record, rel->schema, 0, &key));
+  CHECK_TRUE(isTestRecord(record, rel->schema, key->v.intV, key->v.intV % 4 ? PARALLEL_LENGTH : NAME_LENGTH),
+      "parallel scan reads the record's latest contents");
+  pthread_mutex_lock(&result->lock);
+  if (result->seen[key->v.intV])
+    result->duplicates++;
+  result->seen[key->v.intV] = TRUE;
+  result->count++;
+  hold = !result->held && pthread_equal(pthread_self(), result->caller);
+  result->held |= hold;
+  if (!pthread_equal(pthread_self(), result->caller))
+    {
+      result->sawOtherWorker = TRUE;
+      pthread_cond_broadcast(&result->otherWorker);
+    }
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += 5;
+  while (hold && !result->sawOtherWorker
+      && pthread_cond_timedwait(&result->otherWorker, &result->lock, &deadline) == 0)
+    ;
+  pthread_mutex_unlock(&result->lock);
+  freeVal(key);
+  return RC_OK;
+}
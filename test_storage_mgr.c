@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "dberror.h"
+#include "storage_mgr.h"
+#include "test_helper.h"
+
+#define TEST_FILE "teststorage.bin"
+#define NUM_PAGES 40
+
+// test methods
+static void testCompressedReopenWithoutClose (void);
+
+// helper methods
+static void fillPage (SM_PageHandle page, int pageNum, int version);
+static void writeAndExit (int version);
+static void checkPages (SM_FileHandle *fh, int version);
+
+// test name
+char *testName;
+
+// main method
+int
+main (void)
+{
+  testName = "";
+
+  initStorageManager();
+  testCompressedReopenWithoutClose();
+  return 0;
+}
+
+// ************************************************************
+void
+testCompressedReopenWithoutClose (void)
+{
+  SM_FileHandle fh;
+  int status;
+  pid_t child;
+
+  testName = "test reopening a compressed file that was never closed";
+
+  setPageCompression(1);
+  TEST_CHECK(createPageFile(TEST_FILE));
+  setPageCompression(0);
+
+  // the child writes every page, rewrites some so they move to other slots,
+  // and exits without closing the file, as a crash would
+  child = fork();
+  if (child == 0)
+    writeAndExit(1);
+  CHECK_TRUE(waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0,
+      "writer exited without closing the file");
+
+  TEST_CHECK(openPageFile(TEST_FILE, &fh));
+  CHECK_EQUALS_INT(NUM_PAGES, fh.totalNumPages, "page count survives");
+  checkPages(&fh, 1);
+  TEST_CHECK(closePageFile(&fh));
+
+  // once more on top of the file the first writer left behind: new slots
+  // must not land on the map or on pages still in use
+  child = fork();
+  if (child == 0)
+    writeAndExit(2);
+  CHECK_TRUE(waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0,
+      "second writer exited without closing the file");
+
+  TEST_CHECK(openPageFile(TEST_FILE, &fh));
+  checkPages(&fh, 2);
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile(TEST_FILE));
+
+  TEST_DONE();
+}
+
+// ************************************************************
+// pages of even version compress well, odd versions and every fifth page
+// are noise that does not, so rewriting a page often changes its slot size
+void
+fillPage (SM_PageHandle page, int pageNum, int version)
+{
+  int i;
+
+  memset(page, 0, PAGE_SIZE);
+  sprintf(page, "page-%i-version-%i", pageNum, version);
+  if (version % 2 == 1 || pageNum % 5 == 0)
+    {
+      srand(pageNum * 31 + version);
+      for (i = 64; i < PAGE_DATA_SIZE; i++)
+        page[i] = rand() % 256;
+    }
+}
+
+// writes version 0 of every page, then the given version of all of them,
+// half one by one and half in one vectored call, and leaves without closing
+void
+writeAndExit (int version)
+{
+  SM_FileHandle fh;
+  SM_PageHandle pages[NUM_PAGES];
+  int i;
+
+  TEST_CHECK(openPageFile(TEST_FILE, &fh));
+  for (i = 0; i < NUM_PAGES; i++)
+    {
+      pages[i] = (SM_PageHandle) malloc(PAGE_SIZE);
+      fillPage(pages[i], i, 0);
+      TEST_CHECK(writeBlock(i, &fh, pages[i]));
+    }
+  for (i = 0; i < NUM_PAGES / 2; i++)
+    {
+      fillPage(pages[i], i, version);
+      TEST_CHECK(writeBlock(i, &fh, pages[i]));
+    }
+  for (i = NUM_PAGES / 2; i < NUM_PAGES; i++)
+    fillPage(pages[i], i, version);
+  TEST_CHECK(writeBlocks(NUM_PAGES / 2, NUM_PAGES / 2, &fh, pages + NUM_PAGES / 2));
+  _exit(0);
+}
+
+// reads every page back and compares it with what the writer wrote last
+void
+checkPages (SM_FileHandle *fh, int version)
+{
+  char expected[PAGE_SIZE];
+  char page[PAGE_SIZE];
+  int i;
+
+  for (i = 0; i < NUM_PAGES; i++)
+    {
+      TEST_CHECK(readBlock(i, fh, page));
+      fillPage(expected, i, version);
+      CHECK_TRUE(memcmp(expected, page, PAGE_DATA_SIZE) == 0, "page reads back as last written");
+    }
+}